@@ -59,25 +59,50 @@ if [ "$1" != "--no-update" ]; then
   fi
 fi
 
-echo "We're going to do an end-to-end dry run of the autograder to make sure"
-echo "that we can build everything appropriately. This means that you'll need"
-echo "to have a submission/ directory containing a minimally-compilable version"
-echo "of the files you'd expect a student to submit."
-echo
-echo "If that isn't the case, this process won't work."
-echo
 echo "Cleaning up all intermediary files..."
 echo
 
 # Clean the build directory and the tests directory, just in case.
-tools/build.sh build-directory clean
-tools/build.sh test-driver -f Makefile.tests clean
+make -s -C tools && tools/grade --clean || exit 1
 
 echo
-echo "End-to-end dry run..."
+echo "Listing the tests..."
 echo
 
-tools/assemble.sh assembly .autograder.missing.files && TOTAL_POINTS=$(cd assembly && ./run-tests --count-points) || exit 1
+# This only builds the tests and the test driver, so it works without a submission. The
+# one thing that trips it up is a test file that calls into student code outside of any
+# test, such as to initialize a global variable; those need a real build to list.
+if ! tools/grade --test-manifest; then
+  echo
+  echo "Couldn't list the tests without building a submission. Trying again with the"
+  echo "submission in submission/..."
+  echo
+
+  tools/grade --assemble-only && (cd assembly && ./run-tests --test-manifest ../test-manifest.json) || exit 1
+fi
+TOTAL_POINTS=$(tools/grade --count-points) || exit 1
+
+# Each test's timeout is derived from how long it takes on the submission, so this should be
+# run with the reference solution in submission/. The durations recorded here also let the
+# autograder run the slowest tests first.
+if [ -d "submission" ]; then
+  echo
+  echo "End-to-end dry run, to calibrate test timeouts against the submission in"
+  echo "submission/. Ideally, that's your reference solution. Tests it doesn't pass"
+  echo "use the default timeout."
+  echo
+
+  tools/grade --assemble-only || exit 1
+  (cd assembly && ./run-tests --calibrate ../calibration.json -m ../.autograder.missing.files -t ../test-timings.json) || exit 1
+else
+  echo
+  echo "There's no submission/ directory, so we're skipping the end-to-end dry run and"
+  echo "test timeouts won't be calibrated. To calibrate them, put a copy of your reference"
+  echo "solution in submission/ and run this script again."
+fi
+
+# The native tools get rebuilt on the server, so don't ship our copies.
+make -s -C tools clean
 
 echo
 echo "Assembling ZIP archive..."
@@ -89,6 +114,18 @@ if [ -f "my-setup.sh" ]; then
   ZIP_FILE_LIST+=" my-setup.sh"
 fi
 
+if [ -f "test-timings.json" ]; then
+  ZIP_FILE_LIST+=" test-timings.json"
+fi
+
+if [ -f "test-manifest.json" ]; then
+  ZIP_FILE_LIST+=" test-manifest.json"
+fi
+
+if [ -f "calibration.json" ]; then
+  ZIP_FILE_LIST+=" calibration.json"
+fi
+
 if [ -d "default-files" ]; then
   ZIP_FILE_LIST+=" default-files"
 fi
@@ -0,0 +1,60 @@
+#!/bin/bash
+#
+# Writes a synthetic test suite for benchmarking the test driver.
+#
+#   make-suite.sh DIRECTORY COUNT KIND [DEPTH]
+#
+# creates COUNT tests in DIRECTORY, spread across several .cpp files so they build in parallel.
+# KIND says what each test does:
+#
+#   tiny      passes immediately
+#   crashing  calls abort()
+#   hanging   spins until it times out
+#   chatty    writes 100KB of output, then passes
+#
+# Each file's tests sit inside DEPTH nested test groups (default 1).
+
+if [ $# -lt 3 ]; then
+  echo "Usage: $0 DIRECTORY COUNT KIND [DEPTH]"
+  exit 1
+fi
+
+DIRECTORY=$1
+COUNT=$2
+KIND=$3
+DEPTH=${4:-1}
+
+# Test files are identified by the hash of their contents, and each test needs a line of its
+# own, so keep files to a reasonable size.
+TESTS_PER_FILE=500
+
+case "$KIND" in
+  tiny)     BODY='' ;;
+  crashing) BODY='std::abort();' ;;
+  hanging)  BODY='for (volatile bool forever = true; forever; ) { }' ;;
+  chatty)   BODY='for (int i = 0; i < 1000; i++) std::cout << std::string(99, '"'"'x'"'"') << std::endl;' ;;
+  *)        echo "Unknown test kind: $KIND"; exit 1 ;;
+esac
+
+mkdir -p "$DIRECTORY" || exit 1
+
+FILE=0
+for (( FIRST = 0; FIRST < COUNT; FIRST += TESTS_PER_FILE )); do
+  LAST=$(( FIRST + TESTS_PER_FILE < COUNT ? FIRST + TESTS_PER_FILE : COUNT ))
+  {
+    echo '#include "TestCase.h"'
+    echo '#include <iostream>'
+    echo '#include <string>'
+    echo '#include <cstdlib>'
+    for (( LEVEL = 0; LEVEL < DEPTH; LEVEL++ )); do
+      echo "TEST_GROUP(\"Bench $KIND $FILE level $LEVEL\") {"
+    done
+    for (( TEST = FIRST; TEST < LAST; TEST++ )); do
+      echo "  ADD_TEST(\"$KIND test $TEST\") { $BODY }"
+    done
+    for (( LEVEL = 0; LEVEL < DEPTH; LEVEL++ )); do
+      echo "}"
+    done
+  } > "$DIRECTORY/Bench$FILE.cpp"
+  FILE=$(( FILE + 1 ))
+done
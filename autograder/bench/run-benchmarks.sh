@@ -0,0 +1,69 @@
+#!/bin/bash
+#
+# Measures the overhead of the test driver itself by building and running synthetic suites.
+#
+#   run-benchmarks.sh [RESULTS-FILE] [SUITE...]
+#
+# Each suite is named COUNT-KIND or COUNT-KIND-DEPTH (see make-suite.sh); with none given, a
+# standard set is run. For each suite, one JSON object is appended to RESULTS-FILE (default
+# bench-results.jsonl) with the time taken to copy and build the driver and tests, the wall
+# time of the run, and the driver's own per-stage timings from --stage-timings.
+#
+# Set JOBS to run tests in parallel, and DRIVER_FLAGS to pass other flags to run-tests.
+
+BENCH_DIRECTORY=$(cd "$(dirname "$0")" && pwd)
+DRIVER_DIRECTORY="$BENCH_DIRECTORY/../test-driver"
+
+RESULTS=$(realpath "${1:-bench-results.jsonl}")
+shift
+
+SUITES="$@"
+if [ -z "$SUITES" ]; then
+  SUITES="1-tiny 100-tiny 10000-tiny 100-crashing 10-hanging 100-chatty 100-tiny-50"
+fi
+
+JOBS=${JOBS:-1}
+
+# Hanging tests only measure the cost of timing out, so don't wait long for them.
+HANG_TIMEOUT=0.5
+
+now() {
+  date +%s.%N
+}
+
+elapsed() {
+  awk "BEGIN { printf \"%.6f\", $(now) - $1 }"
+}
+
+for SUITE in $SUITES; do
+  IFS=- read COUNT KIND DEPTH <<< "$SUITE"
+  echo "Benchmarking $SUITE..."
+  
+  WORK_DIRECTORY=$(mktemp -d)
+  
+  START=$(now)
+  cp -r "$DRIVER_DIRECTORY"/. "$WORK_DIRECTORY" || exit 1
+  find "$WORK_DIRECTORY" -name '*.o' -delete
+  "$BENCH_DIRECTORY/make-suite.sh" "$WORK_DIRECTORY" "$COUNT" "$KIND" "$DEPTH" || exit 1
+  COPY_TIME=$(elapsed $START)
+  
+  START=$(now)
+  make -s -C "$WORK_DIRECTORY" -f Makefile.tests -j"$(nproc)" > /dev/null || exit 1
+  BUILD_TIME=$(elapsed $START)
+  
+  EXTRA_FLAGS=""
+  if [ "$KIND" == "hanging" ]; then
+    EXTRA_FLAGS="--timeout $HANG_TIMEOUT"
+  fi
+  
+  START=$(now)
+  (cd "$WORK_DIRECTORY" &&
+   ./run-tests -o results.json -m /dev/null -p "$JOBS" --stage-timings stages.json $EXTRA_FLAGS $DRIVER_FLAGS) > /dev/null || exit 1
+  RUN_TIME=$(elapsed $START)
+  
+  echo "{\"suite\":\"$SUITE\",\"copy\":$COPY_TIME,\"build\":$BUILD_TIME,\"run\":$RUN_TIME,\"driver\":$(cat "$WORK_DIRECTORY/stages.json")}" >> "$RESULTS"
+  
+  rm -rf "$WORK_DIRECTORY"
+done
+
+echo "Results appended to $RESULTS"
@@ -1,5 +1,5 @@
 # Install dependencies.
-apt-get install python3 build-essential -y
+apt-get install build-essential -y
 
 # Move everything into the same directory arrangment as in the local version
 mv autograder/source/* autograder/
@@ -9,7 +9,10 @@ if [ -f "autograder/my-setup.sh" ]; then
   autograder/my-setup.sh || exit 1
 fi
 
-# Build everything in the build-directory once as a clean build so that we
-# don't have to recompile things later.
+# Build the native tools used to grade submissions.
 cd autograder
-tools/build.sh "build-directory"
+make -C tools || exit 1
+
+# Build everything in the build-directory once as a clean build, and prebuild
+# the tests against it, so that we don't have to recompile things later.
+tools/grade --setup
@@ -1,9 +1,26 @@
 #include "Test.h"
 #include "TestCase.h"
 #include "TestCommon.h"
+#include "TestChannel.h"
+#include "TestStackDump.h"
+#include "TestCapture.h"
+#include "TestOptions.h"
+#include "TestScheduler.h"
+#include "TestAllocations.h"
+#include "TestCheckpoint.h"
+#include "TestConcurrency.h"
+#include "TestScratch.h"
+#include "TestMetrics.h"
+#include "JSON.h"
 #include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <setjmp.h>
 #include <iostream>
 #include <sstream>
 #include <cstdint>
@@ -13,7 +30,12 @@
 #include <cstring>
 #include <atomic>
 #include <thread>
+#include <mutex>
+#include <memory>
+#include <filesystem>
 #include <algorithm>
+#include <cerrno>
+#include <cstdio>
 using namespace std;
 
 /* * * * * Test Implementation * * * * */
@@ -25,11 +47,24 @@ string Test::name() const {
   return theName;
 }
 
+void Test::cleanUp() {
+  // Nothing to do by default.
+}
+
+bool Test::definedIn(const set<string> &) const {
+  return false;
+}
+
+string sourceFileName(const string& file) {
+  return filesystem::path(file).lexically_normal().string();
+}
+
 /* * * * * TestCase Implementation * * * * */
 TestCase::TestCase(const string& name,
                    function<void ()> theTest,
-                   Points numPoints)
-: Test(name), testCase(theTest), numPoints(numPoints) {
+                   Points numPoints,
+                   bool timingSensitive)
+: Test(name), testCase(theTest), numPoints(numPoints), timingSensitive(timingSensitive) {
   if (numPoints == kDetermineAutomatically) {
     emergencyAbort("Cannot determine number of points in a test case automatically.");
   }
@@ -37,39 +72,98 @@ TestCase::TestCase(const string& name,
 
 namespace {
   /* Helper function that, given a function, evaluates that function and returns a
-   * status code based on how it went.
+   * status code based on how it went. Diagnostic information for the driver log is
+   * written to the given stream.
    */
-  tuple<Result, string> evaluateTestCase(function<void ()> testCase) {
+  tuple<Result, string> evaluateTestCase(function<void ()> testCase, ostream& log) {
     try {
       testCase();
       return make_tuple(Result::PASS, "");
     } catch (const TestSucceededException &) {
       return make_tuple(Result::PASS, "");
     } catch (const TestFailedException& e) {
-      cerr << "  Test failed: " << e.what() << endl;
+      log << "  Test failed: " << e.what() << endl;
       return make_tuple(Result::FAIL, "");
     } catch (const TestFailedVisiblyException& e) {
-      cerr << "  Test failed visibly: " << e.what() << endl;
+      log << "  Test failed visibly: " << e.what() << endl;
       return make_tuple(Result::VISIBLE_FAIL, e.what());
     } catch (const InternalErrorException& e) {
-      cerr << "  INTERNAL TEST CASE FAILURE: " << e.what() << endl;
-      return make_tuple(Result::INTERNAL_ERROR, "");
+      log << "  INTERNAL TEST CASE FAILURE: " << e.what() << endl;
+      return make_tuple(Result::INTERNAL_ERROR, e.what());
     } catch (const exception& e) {
-      cerr << "  Exception: " << e.what() << endl;
+      log << "  Exception: " << e.what() << endl;
       return make_tuple(Result::EXCEPTION, "");
     } catch (...) {
-      cerr << "  Unknown exception generated." << endl;
+      log << "  Unknown exception generated." << endl;
       return make_tuple(Result::EXCEPTION, "");
     }
   }
  
-  /* Child process handler. */
-  [[ noreturn ]] void childProcessHandler(function<void ()> testCase, uint8_t xorKey, int pipeFD) {
+  /* Moves the current process onto the given CPU, then keeps that CPU busy for the warm-up
+   * period so that it's out of any power-saving state by the time the test starts. If we
+   * can't pin ourselves, the test still runs, just less reliably.
+   */
+  void pinToCPU(int cpu, ostream& log) {
+    recordAvailableCPUs();
+    
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) == -1) {
+      log << "  Couldn't pin test to CPU " << cpu << ": " << strerror(errno) << endl;
+      return;
+    }
+    
+    auto end = chrono::steady_clock::now() + testOptions().timingWarmup;
+    while (chrono::steady_clock::now() < end) {
+      // Spin
+    }
+  }
+  
+  /* Where the child keeps its end of the result pipe. */
+  const int kChildPipeFD = STDERR_FILENO + 1;
+  
+  /* Child process handler. Anything the test writes to stdout or stderr goes to
+   * outputFD, and everything meant for the driver goes across pipeFD.
+   */
+  [[ noreturn ]] void childProcessHandler(function<void ()> testCase, uint8_t xorKey,
+                                          int pipeFD, int outputFD, int cpu,
+                                          const string& workingDirectory) {
+    if (dup2(outputFD, STDOUT_FILENO) == -1 ||
+        dup2(outputFD, STDERR_FILENO) == -1) {
+      emergencyAbort("Couldn't redirect test output.");
+    }
+    
+    /* Other tests may be running at the same time, and we may have inherited the ends of
+     * their pipes. Holding those open would keep their parents from noticing when they
+     * finish, so we close everything except our own pipe, which we move to a known spot.
+     */
+    if (pipeFD != kChildPipeFD) {
+      if (dup2(pipeFD, kChildPipeFD) == -1) emergencyAbort("Couldn't move result pipe.");
+      pipeFD = kChildPipeFD;
+    }
+    if (close_range(kChildPipeFD + 1, ~0U, 0) == -1) emergencyAbort("Couldn't close inherited files.");
+  
+    if (!workingDirectory.empty() && chdir(workingDirectory.c_str()) == -1) {
+      emergencyAbort("Couldn't move into test data directory " + workingDirectory + ".");
+    }
+  
+    /* If we take too long, the parent will ask us where we're stuck. */
+    installStackDumpHandler(pipeFD);
+    installCheckpointHandlers(pipeFD, xorKey);
+    setDriverChannel(pipeFD);
+  
     Result result;
     string message;
+    ostringstream log;
+    
+    /* Timing-sensitive tests get a CPU to themselves. */
+    if (cpu != -1) pinToCPU(cpu, log);
+    
+    enableAllocationTracking();
     
     /* Evaluate the test case and see what we get back. */
-    tie(result, message) = evaluateTestCase(testCase);
+    tie(result, message) = evaluateTestCase(testCase, log);
   
     /* Encode the result with our XOR key. */
     char codedResult = static_cast<uint8_t>(result) ^ xorKey;
@@ -79,89 +173,238 @@ namespace {
      */
     string pipeMessage = codedResult + message;
     
-    /* Write this back across the pipe. */
-    size_t index = 0;
-    while (index != pipeMessage.size()) {
-      auto written = write(pipeFD, pipeMessage.c_str(), pipeMessage.size() - index);
-      if (written == -1) emergencyAbort("Couldn't write data across pipe.");
-        
-      index += written;
-    }
+    /* Everything the test printed has to be on its way before the parent hears that we're
+     * done, since it stops watching for output once it has our result.
+     */
+    cout.flush();
+    cerr.flush();
+    fflush(nullptr);
     
-    /* Terminate normally. We're done. */
-    exit(0);
-  }
-  
-  /* Given a file descriptor, reads the data from the child process from that descriptor,
-   * returning what was read back.
-   */
-  const size_t kBufferSize = 1; // TODO: Make this bigger. This is just for testing.
-  tuple<Result, string> readResult(int fd, uint8_t xorKey) {
-    /* Build a string consisting of all the bytes we read back. */
-    string data;
+    /* Write this back across the pipe. A stack dump request or a SIGTERM arriving partway
+     * through would have its handler splice a record into the middle of ours, so hold those
+     * off until we're done.
+     */
+    sigset_t recordSignals;
+    sigemptyset(&recordSignals);
+    sigaddset(&recordSignals, kStackDumpSignal);
+    sigaddset(&recordSignals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &recordSignals, nullptr);
     
-    while (true) {
-      char buffer[kBufferSize];
-      auto bytes = read(fd, buffer, kBufferSize);
-      
-      /* Handle errors and EOF. */
-      if (bytes == -1) emergencyAbort("Error reading from child process.");
-      if (bytes ==  0) break;
-      
-      data.append(buffer, buffer + bytes);
+    if ((!log.str().empty() && !writeRecord(pipeFD, RecordType::LOG, log.str())) ||
+        !writeRecord(pipeFD, RecordType::RESULT, pipeMessage)) {
+      emergencyAbort("Couldn't write data across pipe.");
     }
     
-    /* Decompose the data into the response code (byte 0) and everything else. The data
-     * transmitted must be at least one byte for the response code. If we don't get that
-     * back, we'll assume that the child crashed.
+    /* Terminate normally. We're done. We skip static destructors here, since they'd
+     * tear down our copy of any fixtures one piece at a time for no benefit. This also
+     * ends any threads the test left running.
      */
-    if (data.size() < 1) return make_tuple(Result::CRASH, "");
-    
-    Result result  = static_cast<Result>(static_cast<uint8_t>(data[0]) ^ xorKey);
-    string message = data.substr(1);
-    return make_tuple(result, message);
+    _exit(0);
   }
   
-  /* Parent handler for test case. We will wait for a specified time period for the
-   * child to succeed before killing it and considering things a failure.
+  /* Waits until one of the given file descriptors has data to read or the deadline
+   * passes, returning whether there's data available. The descriptors that are ready
+   * are left in the given set. A file descriptor of -1 is ignored.
    */
-  const long kChildWaitTime = 60; // One minute
-  tuple<Result, string> parentProcessHandler(pid_t childPID, uint8_t xorKey, int pipeFD) {
-    /* Use select() to wait until data arrives or some amount of time passes. */
-    fd_set set;
-    FD_ZERO(&set);
-    FD_SET(pipeFD, &set);
+  bool waitForData(int pipeFD, int outputFD, fd_set& ready,
+                   chrono::steady_clock::time_point deadline) {
+    auto remaining = chrono::duration_cast<chrono::microseconds>(deadline - chrono::steady_clock::now());
+    if (remaining.count() < 0) remaining = chrono::microseconds(0);
+    
+    FD_ZERO(&ready);
+    if (pipeFD   != -1) FD_SET(pipeFD,   &ready);
+    if (outputFD != -1) FD_SET(outputFD, &ready);
     
     struct timeval timeout;
-    timeout.tv_sec = kChildWaitTime;
-    timeout.tv_usec = 0;
+    timeout.tv_sec  = remaining.count() / 1000000;
+    timeout.tv_usec = remaining.count() % 1000000;
     
     /* We aren't expecting any signals, and so we won't run select() in a loop. Any signal
      * indicates that something weird has happened.
      */
-    int selectStatus = select(pipeFD + 1, &set, nullptr, nullptr, &timeout);
+    int selectStatus = select(max(pipeFD, outputFD) + 1, &ready, nullptr, nullptr, &timeout);
     if (selectStatus == -1) emergencyAbort("select() failed.");
     
-    /* If nothing is ready to read, we assume the process hasn't yet terminated and that
-     * we need to shut it down.
-     */
+    return selectStatus != 0;
+  }
+  
+  /* Reads whatever output is available, returning false at end-of-file. */
+  bool readOutput(int outputFD, OutputTail& output) {
+    char buffer[4096];
+    
+    auto bytes = read(outputFD, buffer, sizeof(buffer));
+    if (bytes == -1) {
+      if (errno == EINTR) return true;
+      emergencyAbort("Error reading output from child process.");
+    }
+    
+    output.append(buffer, bytes);
+    return bytes != 0;
+  }
+  
+  /* Reads all output that's immediately available without blocking. */
+  void drainOutput(int outputFD, OutputTail& output) {
+    if (fcntl(outputFD, F_SETFL, O_NONBLOCK) == -1) emergencyAbort("fcntl() failed.");
+    
+    char buffer[4096];
+    while (true) {
+      auto bytes = read(outputFD, buffer, sizeof(buffer));
+      if (bytes == -1 && errno == EINTR) continue;
+      if (bytes <= 0) break;
+      
+      output.append(buffer, bytes);
+    }
+  }
+  
+  /* How long a child may take to exit after it's sent its result, or after it's been
+   * killed for timing out, before we kill it outright.
+   */
+  const chrono::milliseconds kReapGraceTime(1000);
+  
+  /* How often to check on a child when there's no way to be told it exited. */
+  const chrono::milliseconds kReapPollInterval(1);
+  
+  /* Waits for the child to exit and returns its status. All the while we keep reading its
+   * output, since a thread it started might still be printing, and a child blocked on a
+   * full pipe would never exit. A child that takes too long is killed.
+   */
+  int reapChild(pid_t childPID, int& outputFD, OutputTail& output, ostream& log) {
+    /* A pidfd becomes readable when the child exits, so we can sleep until then. */
+    int exitFD = syscall(SYS_pidfd_open, childPID, 0);
+    auto deadline = chrono::steady_clock::now() + kReapGraceTime;
+    
+    int status;
+    while (true) {
+      pid_t reaped = waitpid(childPID, &status, WNOHANG);
+      if (reaped == childPID) break;
+      if (reaped == -1 && errno != EINTR) emergencyAbort("Failed to wait for child.");
+      
+      auto now = chrono::steady_clock::now();
+      if (now >= deadline) {
+        log << "  Test process didn't exit after finishing; killing it." << endl;
+        kill(childPID, SIGKILL);
+        while (waitpid(childPID, &status, 0) == -1) {
+          if (errno != EINTR) emergencyAbort("Failed to wait for child.");
+        }
+        break;
+      }
+      
+      fd_set ready;
+      if (waitForData(exitFD, outputFD, ready, exitFD == -1? min(deadline, now + kReapPollInterval) : deadline) &&
+          outputFD != -1 && FD_ISSET(outputFD, &ready) && !readOutput(outputFD, output)) {
+        close(outputFD);
+        outputFD = -1;
+      }
+    }
+    
+    if (exitFD != -1) close(exitFD);
+    return status;
+  }
+  
+  /* Everything the parent learned about how a test went. */
+  struct ChildReport {
     Result result;
     string message;
-    if (selectStatus == 0) {
+    string output;
+    CheckpointProgress progress;
+  };
+  
+  /* Parent handler for test case. We will wait for a specified time period for the
+   * child to succeed. If it doesn't, we ask it for a snapshot of its stacks and give it
+   * a moment to respond, then ask it to terminate, giving it another moment to send its
+   * last checkpoint, and finally kill it and consider things a failure. Meanwhile, we
+   * collect whatever the child prints.
+   */
+  const long kStackDumpGraceTime = 1; // One second
+  const chrono::milliseconds kTerminateGraceTime(500);
+  ChildReport parentProcessHandler(pid_t childPID, uint8_t xorKey, int pipeFD, int outputFD,
+                                   double timeout, ostream& log) {
+    auto deadline = chrono::steady_clock::now() +
+                    chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(timeout));
+    
+    /* Assume the child crashed unless we hear back otherwise. */
+    Result result = Result::CRASH;
+    string message;
+    bool timedOut = false;
+    bool terminating = false;
+    bool haveResult = false;
+    CheckpointProgress progress;
+    
+    OutputTail output(testOptions().outputLimit);
+    RecordReader reader;
+    while (!haveResult) {
+      /* If the deadline passes, the first time around we ask for a stack snapshot and
+       * extend the deadline. The second time around, we ask the child to terminate and
+       * extend it again. The third time around, we give up.
+       */
+      fd_set ready;
+      if (!waitForData(pipeFD, outputFD, ready, deadline)) {
+        if (terminating) break;
+        
+        if (timedOut) {
+          terminating = true;
+          kill(childPID, SIGTERM);
+          deadline = chrono::steady_clock::now() + kTerminateGraceTime;
+          continue;
+        }
+      
+        timedOut = true;
+        log << "  Test timed out. Requesting stack snapshot." << endl;
+        kill(childPID, kStackDumpSignal);
+        deadline = chrono::steady_clock::now() + chrono::seconds(kStackDumpGraceTime);
+        continue;
+      }
+      
+      /* Keep the child's output flowing so that it never blocks writing it. */
+      if (outputFD != -1 && FD_ISSET(outputFD, &ready) && !readOutput(outputFD, output)) {
+        close(outputFD);
+        outputFD = -1;
+      }
+      if (!FD_ISSET(pipeFD, &ready)) continue;
+      
+      /* Stop at end-of-file; the child has terminated. */
+      if (!reader.readFrom(pipeFD)) break;
+      
+      RecordType type;
+      string payload;
+      while (reader.next(type, payload)) {
+        if (type == RecordType::RESULT && !payload.empty()) {
+          result  = static_cast<Result>(static_cast<uint8_t>(payload[0]) ^ xorKey);
+          message = payload.substr(1);
+          haveResult = true;
+        } else if (type == RecordType::LOG) {
+          log << payload << flush;
+        } else if (type == RecordType::CHECKPOINT) {
+          if (!decodeCheckpoint(payload, xorKey, progress)) log << "  Ignoring forged checkpoint." << endl;
+        } else if (type == RecordType::BACKTRACE) {
+          for (const auto& line: describeBacktrace(payload)) {
+            log << "    " << line << endl;
+          }
+        }
+      }
+    }
+    
+    /* If we ran out of time, shut the child down. */
+    if (timedOut) {
       kill(childPID, SIGKILL);
       result = Result::TIMEOUT;
     }
-    /* Otherwise, the child has already terminated. See what we got back. */
-    else {
-      tie(result, message) = readResult(pipeFD, xorKey);
-
-      /* If there was an internal test case error, we need to panic. */
-      if (result == Result::INTERNAL_ERROR) emergencyAbort("Internal error occurred in test.");
-    }
+    
+    /* If there was an internal test case error, we need to panic. */
+    if (result == Result::INTERNAL_ERROR) emergencyAbort("Internal error occurred in test: " + message);
     
     /* Wait for the child to exit. */
-    int childStatus;
-    if (waitpid(childPID, &childStatus, 0) == -1) emergencyAbort("Failed to wait for child.");
+    auto reapStart = chrono::steady_clock::now();
+    int childStatus = reapChild(childPID, outputFD, output, log);
+    runMetrics().recordReap(chrono::duration<double>(chrono::steady_clock::now() - reapStart).count());
+    
+    /* Pick up any output still in the pipe. We don't wait for end-of-file, since anything
+     * the child forked off might still be holding the pipe open.
+     */
+    if (outputFD != -1) {
+      drainOutput(outputFD, output);
+      close(outputFD);
+    }
      
     /* If we ended the test for an abnormal reason, report some diagnostic information. */
     if (result != Result::PASS &&
@@ -169,9 +412,9 @@ namespace {
         result != Result::VISIBLE_FAIL &&
         result != Result::EXCEPTION) {
       if (WIFEXITED(childStatus)) {
-        cout << "  Child process exited abnormally with status code " << WEXITSTATUS(childStatus) << endl;
+        log << "  Child process exited abnormally with status code " << WEXITSTATUS(childStatus) << endl;
       } else if (WIFSIGNALED(childStatus)) {
-        cout << "  Child process terminated by signal " << WTERMSIG(childStatus)
+        log << "  Child process terminated by signal " << WTERMSIG(childStatus)
              << " (" << strsignal(WTERMSIG(childStatus)) << ")" << endl;
       } else {
         emergencyAbort("Child terminated for unknown reason.");
@@ -181,7 +424,7 @@ namespace {
     /* Close our end of the pipe. */
     close(pipeFD);
     
-    return make_tuple(result, message);
+    return { result, message, output.contents(), progress };
   }
   
   /* Returns a random byte. */
@@ -192,7 +435,8 @@ namespace {
   }
 
   /* Helper function to run a test and report how it goes. */
-  tuple<Result, string> runTest(function<void ()> testCase) { 
+  ChildReport runTest(function<void ()> testCase, double timeout, int cpu,
+                      const string& workingDirectory, ostream& log) { 
     /* Just to guard against someone trying to guess what status code to return,
      * we'll introduce a random one-byte XOR mask.
      */
@@ -202,33 +446,273 @@ namespace {
     int pipes[2];
     if (pipe(pipes) == -1) emergencyAbort("Couldn't create child/parent pipe.");
     
+    /* Create another pipe to collect whatever the child prints. */
+    int outputPipes[2];
+    if (pipe(outputPipes) == -1) emergencyAbort("Couldn't create output pipe.");
+    
     /* Spawn a subprocess to evaluate the function in isolation. This shields us in
      * case the test case leads to a crash.
      */
-    auto pid = fork();
+    pid_t pid;
+    {
+      /* If another thread were partway through writing to cout, the child would get a
+       * copy of the half-written text and might print it again.
+       */
+      lock_guard<mutex> lock(driverOutputLock());
+      cout << flush;
+      
+      auto forkStart = chrono::steady_clock::now();
+      pid = fork();
+      if (pid > 0) runMetrics().recordFork(chrono::duration<double>(chrono::steady_clock::now() - forkStart).count());
+    }
     if (pid == -1) emergencyAbort("fork() failed.");
     
     /* Child needs to do the actual work. */
     if (pid == 0) {
       close(pipes[0]);
-      childProcessHandler(testCase, key, pipes[1]); // Never returns
+      close(outputPipes[0]);
+      childProcessHandler(testCase, key, pipes[1], outputPipes[1], cpu, workingDirectory); // Never returns
     } else {
       close(pipes[1]);
-      return parentProcessHandler(pid, key, pipes[0]);
+      close(outputPipes[1]);
+      return parentProcessHandler(pid, key, pipes[0], outputPipes[0], timeout, log);
+    }
+  }
+  
+  /* Signals that indicate a test crashed. */
+  const int kCrashSignals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+  
+  /* Where to jump back to if the test running on this thread crashes, or null if no test
+   * is running on this thread.
+   */
+  thread_local sigjmp_buf* crashRecovery = nullptr;
+  
+  /* Signal handler for in-process tests. If the crash happened somewhere other than in a
+   * test, we let it take the driver down as usual.
+   */
+  void inProcessCrashHandler(int signal) {
+    if (crashRecovery == nullptr) {
+      struct sigaction action;
+      memset(&action, 0, sizeof(action));
+      action.sa_handler = SIG_DFL;
+      sigaction(signal, &action, nullptr);
+      raise(signal);
+      return;
+    }
+    
+    siglongjmp(*crashRecovery, signal);
+  }
+  
+  /* Gives the current thread an alternate stack to handle signals on, so that it can recover
+   * from running out of stack space. Each thread needs its own.
+   */
+  void prepareAltStack() {
+    thread_local unique_ptr<char[]> altStack;
+    if (altStack) return;
+    
+    const size_t kAltStackSize = 64 * 1024;
+    altStack.reset(new char[kAltStackSize]);
+    
+    stack_t stack;
+    stack.ss_sp    = altStack.get();
+    stack.ss_size  = kAltStackSize;
+    stack.ss_flags = 0;
+    if (sigaltstack(&stack, nullptr) == -1) emergencyAbort("sigaltstack() failed.");
+  }
+  
+  /* Sends the given signal to inProcessCrashHandler, storing the old handler in previous
+   * if it isn't null.
+   */
+  void catchInProcess(int signal, struct sigaction* previous = nullptr) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = inProcessCrashHandler;
+    action.sa_flags   = SA_ONSTACK | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(signal, &action, previous) == -1) emergencyAbort("sigaction() failed.");
+  }
+  
+  /* Sets up the current thread to catch crashes. */
+  void prepareForCrashes() {
+    prepareAltStack();
+    
+    static once_flag handlersInstalled;
+    call_once(handlersInstalled, [] {
+      for (int signal: kCrashSignals) {
+        catchInProcess(signal);
+      }
+    });
+  }
+  
+  /* Runs a test inside the driver process, for --no-fork. This is much faster than forking,
+   * but it's a best-effort affair: a crash skips any cleanup the test would have done, a
+   * test can corrupt the driver or its fixtures for the tests after it, nothing stops a
+   * test that hangs, and output isn't captured. The working directory belongs to the whole
+   * driver, so tests that need to be in a test data directory take turns.
+   */
+  ChildReport runInProcess(function<void ()> testCase, const string& workingDirectory, ostream& log) {
+    prepareForCrashes();
+    
+    static mutex directoryLock;
+    unique_lock<mutex> turn(directoryLock, defer_lock);
+    string previousDirectory;
+    if (!workingDirectory.empty()) {
+      turn.lock();
+      previousDirectory = filesystem::current_path().string();
+      if (chdir(workingDirectory.c_str()) == -1) {
+        emergencyAbort("Couldn't move into test data directory " + workingDirectory + ".");
+      }
+    }
+    
+    Result result = Result::CRASH;
+    string message;
+    
+    sigjmp_buf recovery;
+    int signal = sigsetjmp(recovery, 1);
+    if (signal == 0) {
+      crashRecovery = &recovery;
+      tie(result, message) = evaluateTestCase(testCase, log);
+    } else {
+      log << "  Test crashed with signal " << signal << " (" << strsignal(signal) << ")" << endl;
+    }
+    crashRecovery = nullptr;
+    
+    if (!previousDirectory.empty() && chdir(previousDirectory.c_str()) == -1) {
+      emergencyAbort("Couldn't move back into " + previousDirectory + ".");
+    }
+    if (result == Result::INTERNAL_ERROR) emergencyAbort("Internal error occurred in test: " + message);
+    return { result, message, "", {} };
+  }
+  
+  /* Builds a fixture. That happens in the driver itself, so a fixture that crashes or hangs
+   * would otherwise take the whole run down and leave no results at all. Crashes are caught
+   * the way runInProcess catches them, and a fixture that takes longer than the default test
+   * timeout is abandoned. Either way the fixture is left unbuilt. Returns a description of
+   * what went wrong, or the empty string if nothing did.
+   */
+  string setUpFixture(Fixture* fixture) {
+    prepareAltStack();
+    
+    /* Only for as long as the fixture is being built; forked tests expect the usual handlers. */
+    const int kFixtureSignals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGALRM };
+    struct sigaction previous[size(kFixtureSignals)];
+    for (size_t i = 0; i < size(kFixtureSignals); i++) {
+      catchInProcess(kFixtureSignals[i], &previous[i]);
+    }
+    
+    double timeout = testOptions().defaultTimeout;
+    itimerval timer{}, noTimer{};
+    timer.it_value.tv_sec  = time_t(timeout);
+    timer.it_value.tv_usec = suseconds_t((timeout - time_t(timeout)) * 1000000);
+    
+    string problem;
+    sigjmp_buf recovery;
+    int signal = sigsetjmp(recovery, 1);
+    if (signal == 0) {
+      crashRecovery = &recovery;
+      setitimer(ITIMER_REAL, &timer, nullptr);
+      try {
+        fixture->setUp();
+      } catch (const InternalErrorException& e) {
+        problem = e.what();
+      } catch (const exception& e) {
+        problem = e.what();
+      } catch (...) {
+        problem = "unknown exception.";
+      }
+    } else if (signal == SIGALRM) {
+      ostringstream message;
+      message << "took longer than " << timeout << " seconds.";
+      problem = message.str();
+    } else {
+      problem = "crashed with signal " + to_string(signal) + " (" + strsignal(signal) + ").";
+    }
+    
+    /* The timer has to stop before anything stops catching it. */
+    setitimer(ITIMER_REAL, &noTimer, nullptr);
+    crashRecovery = nullptr;
+    for (size_t i = 0; i < size(kFixtureSignals); i++) {
+      sigaction(kFixtureSignals[i], &previous[i], nullptr);
+    }
+    return problem;
+  }
+  
+  /* Echoes captured output into the driver log, indented so it stands out. */
+  void logOutput(const string& output, ostream& log) {
+    if (output.empty()) return;
+    
+    log << "  Captured output:" << endl;
+    istringstream lines(output);
+    for (string line; getline(lines, line); ) {
+      log << "    | " << line << endl;
     }
   }
 }
 
-shared_ptr<TestResult> TestCase::run(const std::set<std::string> & /* unused */) {
+shared_ptr<TestResult> TestCase::execute(double timeout, ostream& log, int cpu, bool needsScratch) {
   /* Run the test and see how it went. */
-  cout << "Running test: " << name() << endl;
+  log << "Running test: " << name() << endl;
+  if (cpu != -1 && !testOptions().noFork) log << "  Running alone on CPU " << cpu << "." << endl;
   
-  Result result;
-  string message;
-  tie(result, message) = runTest(testCase);
-  cout << "  Result: " << to_string(result) << endl;
+  /* With test data, tests that change files get a scratch directory of their own, and the
+   * rest all share one copy.
+   */
+  unique_ptr<ScratchDirectory> scratch;
+  string workingDirectory;
+  if (!testOptions().testData.empty()) {
+    if (needsScratch) scratch = make_unique<ScratchDirectory>();
+    workingDirectory = scratch? scratch->path() : sharedTestData();
+  }
+  
+  limitCheckpoints(pointsPossible());
+  auto report = testOptions().noFork? runInProcess(testCase, workingDirectory, log)
+                                     : runTest(testCase, timeout, cpu, workingDirectory, log);
+  logOutput(report.output, log);
   
-  return make_shared<SingleTestResult>(result, message, pointsPossible(), name());
+  if (scratch) {
+    log << "  Scratch space used: " << scratch->spaceUsed() << " bytes" << endl;
+  }
+  log << "  Result: " << to_string(report.result) << endl;
+  
+  /* A test that was cut short may still have gotten somewhere. */
+  string checkpoint;
+  Points partialCredit = 0;
+  if (report.result == Result::TIMEOUT || report.result == Result::CRASH) {
+    const auto& progress = report.progress;
+    if (progress.reached != 0) {
+      checkpoint = progress.phase;
+      log << "  Last checkpoint reached: \"" << checkpoint << "\" (" << progress.reached;
+      if (progress.total != 0) log << " of " << progress.total;
+      log << ")" << endl;
+    }
+    if (progress.total != 0) {
+      partialCredit = pointsPossible() * min(progress.reached, progress.total) / progress.total;
+      log << "  Partial credit: " << partialCredit << " / " << pointsPossible() << endl;
+    }
+  }
+  
+  return make_shared<SingleTestResult>(report.result, report.message, pointsPossible(), name(),
+                                       report.output, testOptions().showOutput,
+                                       checkpoint, partialCredit);
+}
+
+void TestCase::gather(const set<string> & /* unused */, const string& path,
+                      vector<ScheduledTest>& work) {
+  work.push_back({ path.empty()? name() : path + " / " + name(),
+                   static_pointer_cast<TestCase>(shared_from_this()),
+                   timingSensitive });
+}
+
+void TestCase::list(const set<string>& missingFiles, const string& path,
+                    vector<ScheduledTest>& work) {
+  gather(missingFiles, path, work);
+}
+
+shared_ptr<TestResult> TestCase::report(const set<string> & /* unused */,
+                                        const Outcomes& outcomes) const {
+  auto outcome = outcomes.find(this);
+  if (outcome == outcomes.end()) emergencyAbort("Test " + name() + " was never run.");
+  return outcome->second;
 }
 
 Points TestCase::pointsPossible() const {
@@ -239,13 +723,26 @@ size_t TestCase::numTests() const {
   return 1;
 }
 
+JSON TestCase::manifest() const {
+  return JSON::object({
+    { "name",             name()          },
+    { "points",           numPoints       },
+    { "timing_sensitive", timingSensitive },
+  });
+}
+
 /* * * * * TestGroup Implementation * * * * */
 
-TestGroup::TestGroup(const string& name, Points numPoints)
-  : Test(name), numPoints(numPoints) {
+TestGroup::TestGroup(const string& name, Points numPoints, const string& sourceFile)
+  : Test(name), numPoints(numPoints), sourceFile(sourceFile) {
   
 }
 
+bool TestGroup::definedIn(const set<string>& files) const {
+  if (files.count(sourceFile)) return true;
+  return any_of(tests.begin(), tests.end(), [&](auto test) { return test.second->definedIn(files); });
+}
+
 void TestGroup::addTest(shared_ptr<Test> test) {
   /* Add the test by name. */
   if (tests.count(test->name())) emergencyAbort("Duplicate test case: " + test->name());
@@ -260,19 +757,64 @@ shared_ptr<Test> TestGroup::testNamed(const string& name) const {
   return tests.at(name);
 }
 
-shared_ptr<TestResult> TestGroup::run(const std::set<std::string>& missingFiles) {
-  /* Edge case: if not all needed files were submitted, report an error. */
-  if (any_of(requirements.begin(), requirements.end(), [&](auto req) { return missingFiles.count(req); })) {
+bool TestGroup::isMissingFiles(const set<string>& missingFiles) const {
+  return any_of(requirements.begin(), requirements.end(), [&](auto req) { return missingFiles.count(req); });
+}
+
+void TestGroup::gather(const set<string>& missingFiles, const string& path,
+                       vector<ScheduledTest>& work) {
+  /* Edge case: if not all needed files were submitted, there's nothing to run. */
+  if (isMissingFiles(missingFiles)) return;
+
+  /* Build any shared state the tests need. If that fails, none of the tests can run. */
+  for (auto fixture: fixtures) {
+    string problem = setUpFixture(fixture);
+    if (problem.empty()) continue;
+    
+    cout << "Setting up fixtures for " << name() << " failed: " << problem << endl;
+    fixturesFailed = true;
+    return;
+  }
+
+  /* Otherwise, everything's ready. Gather the tests. */
+  size_t first = work.size();
+  for (auto test: tests) {
+    test.second->gather(missingFiles, path.empty()? name() : path + " / " + name(), work);
+  }
+  
+  /* Everything in a timing-sensitive group is timing-sensitive, and likewise for scratch. */
+  for (size_t i = first; i < work.size(); i++) {
+    if (amITimingSensitive) work[i].timingSensitive = true;
+    if (amIGivingScratch)   work[i].needsScratch    = true;
+  }
+}
+
+void TestGroup::list(const set<string>& missingFiles, const string& path,
+                     vector<ScheduledTest>& work) {
+  if (isMissingFiles(missingFiles)) return;
+  
+  for (auto test: tests) {
+    test.second->list(missingFiles, path.empty()? name() : path + " / " + name(), work);
+  }
+}
+
+shared_ptr<TestResult> TestGroup::report(const set<string>& missingFiles,
+                                         const Outcomes& outcomes) const {
+  /* Edge cases: tests that couldn't be run. */
+  if (isMissingFiles(missingFiles)) {
     return make_shared<MissingFileTestResult>(pointsPossible(), name());
   }
+  if (fixturesFailed) {
+    return make_shared<FixtureFailedTestResult>(pointsPossible(), name());
+  }
 
-  /* Otherwise, all files are submitted. Run the tests. */
+  /* Otherwise, all the tests were run. */
   set<shared_ptr<TestResult>> children;
   Score score;
   
-  /* Run each test, incorporating the information we find. */
+  /* Report each test, incorporating the information we find. */
   for (auto test: tests) {
-    auto oneResult = test.second->run(missingFiles);
+    auto oneResult = test.second->report(missingFiles, outcomes);
     
     children.insert(oneResult);
     
@@ -298,6 +840,17 @@ shared_ptr<TestResult> TestGroup::run(const std::set<std::string>& missingFiles)
   }
 }
 
+void TestGroup::cleanUp() {
+  /* The shared state is no longer needed. */
+  for (auto fixture: fixtures) {
+    fixture->tearDown();
+  }
+  
+  for (auto test: tests) {
+    test.second->cleanUp();
+  }
+}
+
 set<string> TestGroup::requiredFiles() const {
   return requirements;
 }
@@ -306,10 +859,22 @@ void TestGroup::addRequirement(const string& filename) {
   requirements.insert(filename);
 }
 
+void TestGroup::addFixture(Fixture* fixture) {
+  fixtures.push_back(fixture);
+}
+
 void TestGroup::setPublic(bool isPublic) {
   amIPublic = isPublic;
 }
 
+void TestGroup::setTimingSensitive() {
+  amITimingSensitive = true;
+}
+
+void TestGroup::giveTestsScratch() {
+  amIGivingScratch = true;
+}
+
 Points TestGroup::pointsPossible() const {
   /* If we have a fixed number of points, return that. */
   if (numPoints != kDetermineAutomatically) return numPoints;
@@ -329,3 +894,20 @@ size_t TestGroup::numTests() const {
   }
   return result;
 }
+
+JSON TestGroup::manifest() const {
+  vector<JSON> children;
+  for (auto test: tests) {
+    children.push_back(test.second->manifest());
+  }
+  
+  return JSON::object({
+    { "name",             name()                                                },
+    { "source_file",      sourceFile                                            },
+    { "points",           pointsPossible()                                      },
+    { "visible",          isPublic()                                            },
+    { "timing_sensitive", amITimingSensitive                                    },
+    { "required_files",   vector<JSON>(requirements.begin(), requirements.end()) },
+    { "tests",            children                                              }
+  });
+}
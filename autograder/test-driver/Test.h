@@ -11,13 +11,51 @@
 #include <limits>
 #include <ostream>
 
-/* Type representing some sort of test that can be run. */
+class Test;
+class TestCase;
+class JSON;
+
+/* A test case that's ready to run, along with its full name in the test tree. */
+struct ScheduledTest {
+  std::string key;                 // Names of the enclosing groups and the test, e.g. "Group / Test"
+  std::shared_ptr<TestCase> test;
+  bool timingSensitive;            // Whether it must run with nothing else going on
+  bool needsScratch = false;       // Whether it gets a private copy of the test data
+};
+
+/* How each test case that was run turned out. */
+using Outcomes = std::map<const Test*, std::shared_ptr<TestResult>>;
+
+/* Type representing some sort of test that can be run. Running tests happens in two steps.
+ * First, gather() collects all the test cases that need to be run. Once those have run,
+ * report() assembles their outcomes into a collection of test results.
+ */
 class Test: public std::enable_shared_from_this<Test> {
 public:
   virtual ~Test() = default;
   
-  /* Runs the tests, returning a collection of test results. */
-  virtual std::shared_ptr<TestResult> run(const std::set<std::string>& missingFiles) = 0;
+  /* Adds all the test cases that need to run to the list of work. The path parameter is
+   * the key of the enclosing group, or empty for the root.
+   */
+  virtual void gather(const std::set<std::string>& missingFiles, const std::string& path,
+                      std::vector<ScheduledTest>& work) = 0;
+  
+  /* Given how the test cases turned out, returns a collection of test results. */
+  virtual std::shared_ptr<TestResult> report(const std::set<std::string>& missingFiles,
+                                             const Outcomes& outcomes) const = 0;
+  
+  /* Adds all the test cases to the list of work, as gather() does, but without setting up
+   * anything they'd need in order to run. This is for tests whose results from an earlier
+   * run are being reused.
+   */
+  virtual void list(const std::set<std::string>& missingFiles, const std::string& path,
+                    std::vector<ScheduledTest>& work) = 0;
+  
+  /* Releases anything gather() set up. */
+  virtual void cleanUp();
+  
+  /* Returns whether any part of this test was defined in one of the given source files. */
+  virtual bool definedIn(const std::set<std::string>& files) const;
   
   /* Returns how many points this test is worth. */
   virtual Points pointsPossible() const = 0;
@@ -25,6 +63,11 @@ public:
   /* How many tests are grouped here. */
   virtual std::size_t numTests() const = 0;
   
+  /* Describes this test for the test manifest: its name and points, and for a group,
+   * everything about how it's set up and all the tests inside it.
+   */
+  virtual JSON manifest() const = 0;
+  
   /* Returns the name of this test. */
   std::string name() const;
   
@@ -35,15 +78,50 @@ private:
   const std::string theName;
 };
 
+/* Type representing state shared by all the tests in a group. The driver sets fixtures up
+ * when gathering the tests, before any of them run, so each test's child process inherits a
+ * copy of the finished state rather than building it itself. They're torn down in cleanUp(),
+ * once every test has been reported.
+ */
+class Fixture {
+public:
+  virtual ~Fixture() = default;
+  
+  /* Builds the shared state. This may throw if something goes wrong. */
+  virtual void setUp() = 0;
+  
+  /* Releases the shared state. */
+  virtual void tearDown() = 0;
+};
+
 /* Type representing an individual test case. */
 class TestCase: public Test {
 public:
   TestCase(const std::string& name,
            std::function<void ()> theTest,
-           Points numPoints = 1);
+           Points numPoints = 1,
+           bool timingSensitive = false);
 
-  /* Runs the individual test, returning how it went. */
-  std::shared_ptr<TestResult> run(const std::set<std::string> &) override;
+  /* Runs the individual test in its own process, giving up after the given number of
+   * seconds, and returns how it went. Information for the driver log is written to log
+   * rather than straight to cout, since several tests may be running at once. If a CPU
+   * is given, the test is pinned to it. If there's test data, the test runs in a scratch
+   * directory of its own if needsScratch is set, and in the shared copy otherwise.
+   */
+  std::shared_ptr<TestResult> execute(double timeout, std::ostream& log, int cpu = -1,
+                                      bool needsScratch = false);
+  
+  /* Schedules this test. */
+  void gather(const std::set<std::string>& missingFiles, const std::string& path,
+              std::vector<ScheduledTest>& work) override;
+  
+  /* There's nothing to set up, so this is the same as gathering. */
+  void list(const std::set<std::string>& missingFiles, const std::string& path,
+            std::vector<ScheduledTest>& work) override;
+  
+  /* Reports the outcome of this test. */
+  std::shared_ptr<TestResult> report(const std::set<std::string>& missingFiles,
+                                     const Outcomes& outcomes) const override;
   
   /* Returns the underlying number of points. */
   Points pointsPossible() const override;
@@ -51,15 +129,20 @@ public:
   /* There's just one test. */
   std::size_t numTests() const override;
   
+  /* Its name, points, and whether it's timing-sensitive. */
+  JSON manifest() const override;
+  
 private:
   std::function<void ()> testCase;
   Points numPoints;
+  bool timingSensitive;
 };
 
 /* Type representing a group of test cases. */
 class TestGroup: public Test {
 public:
-  TestGroup(const std::string& name, Points = kDetermineAutomatically);
+  TestGroup(const std::string& name, Points = kDetermineAutomatically,
+            const std::string& sourceFile = "");
   
   /* Adds a in new test to the group. */
   void addTest(std::shared_ptr<Test> test);
@@ -67,8 +150,23 @@ public:
   /* Returns the test with the given name, returning an error if none exists. */
   std::shared_ptr<Test> testNamed(const std::string& name) const;
   
-  /* Runs all the tests in the group. */
-  std::shared_ptr<TestResult> run(const std::set<std::string>& missingFiles) override;
+  /* Sets up the group's fixtures and gathers all the tests in the group. */
+  void gather(const std::set<std::string>& missingFiles, const std::string& path,
+              std::vector<ScheduledTest>& work) override;
+  
+  /* Lists all the tests in the group, leaving the fixtures alone. */
+  void list(const std::set<std::string>& missingFiles, const std::string& path,
+            std::vector<ScheduledTest>& work) override;
+  
+  /* Reports the results of all the tests in the group. */
+  std::shared_ptr<TestResult> report(const std::set<std::string>& missingFiles,
+                                     const Outcomes& outcomes) const override;
+  
+  /* Tears down the group's fixtures. */
+  void cleanUp() override;
+  
+  /* Checks the file the group was defined in, along with any nested groups. */
+  bool definedIn(const std::set<std::string>& files) const override;
   
   /* Returns whether this group of tests is public. */
   bool isPublic() const;
@@ -76,28 +174,53 @@ public:
   /* Changes the visibility of this test case. */
   void setPublic(bool isPublic = true);
   
+  /* Marks all the tests in this group as timing-sensitive. */
+  void setTimingSensitive();
+  
+  /* Gives each test in this group a scratch directory of its own. */
+  void giveTestsScratch();
+  
   /* Returns all the files required to be submitted. */
   std::set<std::string> requiredFiles() const;
   
   /* Adds a new file to the list of requirements. */
   void addRequirement(const std::string& filename);
   
+  /* Adds a fixture to set up when the group's tests are gathered. */
+  void addFixture(Fixture* fixture);
+  
   /* Returns the underlying number of points, or calculates recursively as needed. */
   Points pointsPossible() const override;
   
   /* We can have lots of tests! */
   std::size_t numTests() const override;
   
+  /* Describes the group along with all of its tests. */
+  JSON manifest() const override;
+  
 private:
   std::map<std::string, std::shared_ptr<Test>> tests;
   std::set<std::string> requirements;
+  std::vector<Fixture*> fixtures;
   Points numPoints;
+  std::string sourceFile;
   bool amIPublic = false;
+  bool amITimingSensitive = false;
+  bool amIGivingScratch = false;
+  bool fixturesFailed = false;
+  
+  /* Whether any of our requirements are missing. */
+  bool isMissingFiles(const std::set<std::string>& missingFiles) const;
   
   /* Needed for the test case definitions to be able to assemble tests. */
   friend class RootGroup;
 };
 
+/* Given a source file name, such as __FILE__, returns the name run-tests --from-file
+ * knows that file by.
+ */
+std::string sourceFileName(const std::string& file);
+
 /* Returns a list of all the tests in the root group. */
 std::vector<std::shared_ptr<Test>> allTests();
 
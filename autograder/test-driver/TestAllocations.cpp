@@ -0,0 +1,147 @@
+#include "TestAllocations.h"
+#include <atomic>
+#include <cstddef>
+#include <cerrno>
+#include <malloc.h>
+#include <unistd.h>
+using namespace std;
+
+/* glibc's own allocator, under names that we aren't replacing. */
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void  __libc_free(void* ptr);
+  void* __libc_calloc(size_t count, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+  /* Running totals. Sizes are as reported by malloc_usable_size, which can be a bit more
+   * than what was asked for but is the same when the block is allocated and freed.
+   */
+  bool tracking = false;
+  atomic<uint64_t> totalAllocations(0);
+  atomic<uint64_t> totalBytes(0);
+  atomic<int64_t>  liveBytes(0);
+  atomic<int64_t>  peakBytes(0);
+
+  /* AddressSanitizer brings its own allocator, which ours would hide. Under it, nothing is
+   * counted, which is fine for the sanitizer reruns that are the only use of such builds.
+   */
+#ifndef __SANITIZE_ADDRESS__
+  void recordAllocation(void* ptr) {
+    if (!tracking || ptr == nullptr) return;
+
+    int64_t size = malloc_usable_size(ptr);
+    totalAllocations.fetch_add(1, memory_order_relaxed);
+    totalBytes.fetch_add(size, memory_order_relaxed);
+
+    int64_t live = liveBytes.fetch_add(size, memory_order_relaxed) + size;
+    int64_t peak = peakBytes.load(memory_order_relaxed);
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {
+      // peak was updated; try again
+    }
+  }
+
+  /* Blocks allocated before tracking started look just like any others, so freeing one of
+   * those lowers the live total. Counters therefore measure the net change.
+   */
+  void recordFree(void* ptr) {
+    if (!tracking || ptr == nullptr) return;
+    liveBytes.fetch_sub(malloc_usable_size(ptr), memory_order_relaxed);
+  }
+#endif
+}
+
+/* * * * * Replacement allocator * * * * */
+#ifndef __SANITIZE_ADDRESS__
+extern "C" {
+  void* malloc(size_t size) noexcept {
+    void* result = __libc_malloc(size);
+    recordAllocation(result);
+    return result;
+  }
+
+  void free(void* ptr) noexcept {
+    recordFree(ptr);
+    __libc_free(ptr);
+  }
+
+  void* calloc(size_t count, size_t size) noexcept {
+    void* result = __libc_calloc(count, size);
+    recordAllocation(result);
+    return result;
+  }
+
+  void* realloc(void* ptr, size_t size) noexcept {
+    /* If this fails, the old block is left alone, so we only count it as freed once we
+     * know it's gone.
+     */
+    size_t oldSize = ptr? malloc_usable_size(ptr) : 0;
+    void*  result  = __libc_realloc(ptr, size);
+    if (result == nullptr && size != 0) return nullptr;
+
+    if (tracking && ptr != nullptr) liveBytes.fetch_sub(oldSize, memory_order_relaxed);
+    recordAllocation(result);
+    return result;
+  }
+
+  void* memalign(size_t alignment, size_t size) noexcept {
+    void* result = __libc_memalign(alignment, size);
+    recordAllocation(result);
+    return result;
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    return memalign(alignment, size);
+  }
+
+  void* valloc(size_t size) noexcept {
+    return memalign(sysconf(_SC_PAGESIZE), size);
+  }
+
+  int posix_memalign(void** result, size_t alignment, size_t size) noexcept {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+
+    void* block = memalign(alignment, size);
+    if (block == nullptr) return ENOMEM;
+
+    *result = block;
+    return 0;
+  }
+}
+#endif
+
+void enableAllocationTracking() {
+  tracking = true;
+}
+
+bool isTrackingAllocations() {
+  return tracking;
+}
+
+/* * * * * AllocationCounter Implementation * * * * */
+AllocationCounter::AllocationCounter()
+  : startAllocations(totalAllocations.load()),
+    startBytes(totalBytes.load()),
+    startLive(liveBytes.load()) {
+  peakBytes.store(startLive);
+}
+
+uint64_t AllocationCounter::allocations() const {
+  return totalAllocations.load() - startAllocations;
+}
+
+uint64_t AllocationCounter::bytesAllocated() const {
+  return totalBytes.load() - startBytes;
+}
+
+uint64_t AllocationCounter::peakLiveBytes() const {
+  int64_t peak = peakBytes.load() - startLive;
+  return peak > 0? peak : 0;
+}
+
+uint64_t AllocationCounter::leakedBytes() const {
+  int64_t leaked = liveBytes.load() - startLive;
+  return leaked > 0? leaked : 0;
+}
@@ -0,0 +1,49 @@
+/* Tracking for memory allocations made by test code. The test driver replaces malloc and
+ * friends (which operator new and delete use under the hood) with versions that keep
+ * count. Counting only happens in the child processes that run tests; the driver itself
+ * runs at full speed.
+ */
+
+#ifndef TestAllocations_Included
+#define TestAllocations_Included
+
+#include <cstdint>
+
+/* Turns on allocation tracking for this process. Called by each test's child process. */
+void enableAllocationTracking();
+
+/* Returns whether allocations in this process are being counted. */
+bool isTrackingAllocations();
+
+/* Counts allocations made, by any thread, during its lifetime. For example:
+ *
+ *    AllocationCounter counter;
+ *    Stack moved = std::move(original);
+ *    EXPECT(counter.allocations() == 0);
+ *
+ * Creating a counter resets the peak, so if counters are nested, the outer counter's peak
+ * only covers the time since the inner one was created.
+ */
+class AllocationCounter {
+public:
+  AllocationCounter();
+  
+  /* How many blocks were allocated. */
+  std::uint64_t allocations() const;
+  
+  /* Total size of the blocks allocated. */
+  std::uint64_t bytesAllocated() const;
+  
+  /* Most memory in use at once, beyond what was in use when the counter was created. */
+  std::uint64_t peakLiveBytes() const;
+  
+  /* How much more memory is in use now than when the counter was created. */
+  std::uint64_t leakedBytes() const;
+  
+private:
+  std::uint64_t startAllocations;
+  std::uint64_t startBytes;
+  std::int64_t  startLive;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "TestCalibration.h"
+#include "TestCommon.h"
+#include "TestOptions.h"
+#include "TestScheduler.h"
+#include "JSON.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <optional>
+using namespace std;
+
+namespace {
+  /* Returns the median of a nonempty list of times. */
+  double medianOf(vector<double> samples) {
+    sort(samples.begin(), samples.end());
+    
+    size_t middle = samples.size() / 2;
+    if (samples.size() % 2 == 1) return samples[middle];
+    return (samples[middle - 1] + samples[middle]) / 2;
+  }
+}
+
+void calibrate(const vector<ScheduledTest>& work, TimingDatabase& timings,
+               const string& filename) {
+  const auto& options = testOptions();
+  
+  map<string, JSON> timeouts;
+  for (const auto& test: work) {
+    vector<double> samples;
+    bool passed = true;
+    
+    /* Timing-sensitive tests get the dedicated CPU to themselves, just as when grading. */
+    optional<DedicatedCPU> dedicated;
+    if (test.timingSensitive) dedicated.emplace();
+    
+    for (size_t run = 0; run < options.calibrationRuns && passed; run++) {
+      ostringstream log;
+      
+      auto start  = chrono::steady_clock::now();
+      auto result = test.test->execute(options.defaultTimeout, log,
+                                       dedicated? dedicated->cpu() : -1, test.needsScratch);
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      
+      /* The reference solution ought to pass everything. If it doesn't, the time it
+       * took tells us nothing, so show what happened.
+       */
+      if (!result->reportFailedTests().empty()) {
+        cout << log.str();
+        passed = false;
+      }
+      samples.push_back(elapsed.count());
+    }
+    
+    if (!passed) {
+      cout << "Warning: reference solution failed " << test.key << "; "
+           << "using the default timeout of " << options.defaultTimeout << "s." << endl;
+      continue;
+    }
+    
+    double median  = medianOf(samples);
+    double timeout = median * options.timeoutMultiplier + options.timeoutFloor;
+    timings.record(test.key, median);
+    timeouts.insert(make_pair(test.key, timeout));
+    
+    cout << fixed << setprecision(3)
+         << test.key << ": median " << median << "s over " << samples.size()
+         << " runs; timeout " << timeout << "s" << endl;
+    cout.unsetf(ios::floatfield);
+  }
+  
+  ofstream output(filename);
+  if (!output) emergencyAbort("Could not open file " + filename + " for writing.");
+  output << JSON(timeouts);
+}
+
+void loadCalibration(const string& filename) {
+  ifstream input(filename);
+  if (!input) emergencyAbort("Cannot open calibration file " + filename + ".");
+  
+  JSON data = JSON::parse(input);
+  for (auto key: data) {
+    testOptions().timeouts[key.asString()] = data[key].asDouble();
+  }
+  testOptions().calibrationFile = filename;
+}
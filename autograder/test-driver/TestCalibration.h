@@ -0,0 +1,26 @@
+/* Functions for deriving per-test timeouts from how long a reference solution takes. The
+ * course staff run calibration against their own solution when assembling the autograder,
+ * and the resulting file is loaded when grading student submissions.
+ */
+
+#ifndef TestCalibration_Included
+#define TestCalibration_Included
+
+#include "Test.h"
+#include "TestTimings.h"
+#include <string>
+#include <vector>
+
+/* Runs each test repeatedly, one at a time, and writes a timeout for each test that passed
+ * to the given file. The median run time for each test is also recorded in the timing
+ * database.
+ */
+void calibrate(const std::vector<ScheduledTest>& work, TimingDatabase& timings,
+               const std::string& filename);
+
+/* Loads timeouts written by calibrate() into the test options, remembering where they came
+ * from.
+ */
+void loadCalibration(const std::string& filename);
+
+#endif
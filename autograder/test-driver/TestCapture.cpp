@@ -0,0 +1,42 @@
+#include "TestCapture.h"
+#include <algorithm>
+using namespace std;
+
+OutputTail::OutputTail(size_t limit) : ring(limit) {
+
+}
+
+void OutputTail::append(const char* data, size_t length) {
+  if (ring.empty()) {
+    total += length;
+    return;
+  }
+
+  /* Only the last ring.size() bytes of the new data can possibly survive. */
+  if (length > ring.size()) {
+    total  += length - ring.size();
+    data   += length - ring.size();
+    length  = ring.size();
+  }
+  
+  /* Copy in up to two pieces, wrapping around the end of the ring. */
+  size_t start = total % ring.size();
+  size_t first = min(length, ring.size() - start);
+  copy(data, data + first, ring.begin() + start);
+  copy(data + first, data + length, ring.begin());
+  
+  total += length;
+}
+
+string OutputTail::contents() const {
+  if (total <= ring.size()) return string(ring.begin(), ring.begin() + total);
+  
+  size_t start = total % ring.size();
+  return "[... " + to_string(total - ring.size()) + " earlier bytes of output omitted ...]\n" +
+         string(ring.begin() + start, ring.end()) +
+         string(ring.begin(), ring.begin() + start);
+}
+
+size_t OutputTail::totalBytes() const {
+  return total;
+}
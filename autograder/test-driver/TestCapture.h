@@ -0,0 +1,31 @@
+/* Types for capturing the output a test's child process writes to stdout and stderr. */
+
+#ifndef TestCapture_Included
+#define TestCapture_Included
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/* Type that holds on to the last few bytes written to it, discarding older data once
+ * the limit is reached. This keeps a chatty test from using unbounded memory.
+ */
+class OutputTail {
+public:
+  explicit OutputTail(std::size_t limit);
+  
+  /* Appends more data. */
+  void append(const char* data, std::size_t length);
+  
+  /* Returns what's been kept, prefixed with a marker if anything was discarded. */
+  std::string contents() const;
+  
+  /* Returns how many bytes were appended in total. */
+  std::size_t totalBytes() const;
+  
+private:
+  std::vector<char> ring;
+  std::size_t total = 0;
+};
+
+#endif
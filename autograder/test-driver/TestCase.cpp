@@ -1,4 +1,5 @@
 #include "TestCase.h"
+#include <sstream>
 using namespace std;
 
 /* * * * * Implementation of unit testing primitives. * * * * */
@@ -31,6 +32,77 @@ void doExpect(bool condition, const char* expression, size_t line, const char* f
   }
 }
 
+void failComparison(const char* expression, const string& lhs, const string& rhs,
+                    const string& detail, size_t line, const char* filename) {
+  hardFailTest(string(expression) + ": left side was " + lhs + ", right side was " + rhs + detail + ".",
+               line, filename);
+}
+
+void TestComparisonDetail::failRangeSizes(size_t lhs, size_t rhs, const char* expression,
+                                          size_t line, const char* filename) {
+  hardFailTest(string(expression) + ": left side has " + to_string(lhs) + " elements, right side has " +
+               to_string(rhs) + ".", line, filename);
+}
+
+void doExpectInstructionsBelow(const Cost& cost, uint64_t limit, const char* expression,
+                               size_t line, const char* filename) {
+  if (cost.instructions >= limit) {
+    hardFailTest(string(expression) + " took " + to_string(cost.instructions) +
+                 " instructions (measured using " + to_string(cost.mode) + "); limit is " +
+                 to_string(limit) + ".", line, filename);
+  }
+}
+
+void doExpectCostRatioBelow(const function<void ()>& code, const function<void ()>& reference,
+                            double ratio, const char* expression, const char* referenceExpression,
+                            size_t line, const char* filename) {
+  /* Measure in the order written, so the driver log reads in that order too. */
+  Cost codeCost      = measureCost(code);
+  Cost referenceCost = measureCost(reference);
+  
+  /* Comparing against the reference's cost, rather than dividing by it, avoids trouble
+   * when the reference does no measurable work.
+   */
+  if (codeCost.instructions >= ratio * referenceCost.instructions) {
+    ostringstream message;
+    message << expression << " took " << codeCost.instructions << " instructions, versus "
+            << referenceCost.instructions << " for " << referenceExpression
+            << " (measured using " << to_string(codeCost.mode) << "); ratio limit is "
+            << ratio << ".";
+    hardFailTest(message.str(), line, filename);
+  }
+}
+
+void doExpectNoLeaks(const function<void ()>& code, const char* expression,
+                     size_t line, const char* filename) {
+  if (!isTrackingAllocations()) {
+    doInternalError("Allocations can only be checked while a test is running.", line, filename);
+  }
+  
+  AllocationCounter counter;
+  code();
+  
+  if (counter.leakedBytes() != 0) {
+    hardFailTest(string(expression) + " leaked " + to_string(counter.leakedBytes()) +
+                 " bytes.", line, filename);
+  }
+}
+
+void doExpectMaxAllocations(const function<void ()>& code, uint64_t limit, const char* expression,
+                            size_t line, const char* filename) {
+  if (!isTrackingAllocations()) {
+    doInternalError("Allocations can only be checked while a test is running.", line, filename);
+  }
+  
+  AllocationCounter counter;
+  code();
+  
+  if (counter.allocations() > limit) {
+    hardFailTest(string(expression) + " made " + to_string(counter.allocations()) +
+                 " allocations; limit is " + to_string(limit) + ".", line, filename);
+  }
+}
+
 /* * * * * Exception types. * * * * */
 TestFailedException::TestFailedException(const string& message, std::size_t line, const char*)
   : logic_error("Line " + to_string(line) + ": " + message) {
@@ -15,6 +15,148 @@
  */
 #define EXPECT(condition) /* Something internal you shouldn't worry about. */
 
+/* Checks how two values compare: EXPECT_EQ that they're equal, EXPECT_LT that the first is
+ * less than the second, and EXPECT_NEAR that they're within some tolerance of one another.
+ * If the check fails, the test fails with a message showing both values. For example:
+ *
+ *     EXPECT_EQ(vec.size(), 3);
+ *     EXPECT_LT(tree.height(), 2 * log2(tree.size() + 1));
+ *     EXPECT_NEAR(average(data), 2.5, 1e-9);
+ *
+ * Values are only turned into text if the check fails, so these cost no more than EXPECT
+ * inside a tight loop. See TestFormatting.h to control how values of your own types print.
+ */
+#define EXPECT_EQ(lhs, rhs)              /* Something internal you shouldn't worry about. */
+#define EXPECT_LT(lhs, rhs)              /* Something internal you shouldn't worry about. */
+#define EXPECT_NEAR(lhs, rhs, tolerance) /* Something internal you shouldn't worry about. */
+
+/* Checks that two arrays, vectors, or other ranges stored contiguously are the same size and
+ * hold equal elements, or elements within some tolerance of one another. If not, the test
+ * fails with a message giving the first place they differ and how many elements differ in
+ * all. For example:
+ *
+ *     EXPECT_RANGE_EQ(studentSort(data), referenceSort(data));
+ *     EXPECT_RANGE_NEAR(multiply(a, b), expectedProduct, 1e-9);
+ *
+ * These are much faster than checking each element with EXPECT, so use them when checking
+ * large outputs.
+ */
+#define EXPECT_RANGE_EQ(lhs, rhs)              /* Something internal you shouldn't worry about. */
+#define EXPECT_RANGE_NEAR(lhs, rhs, tolerance) /* Something internal you shouldn't worry about. */
+
+/* Checks how much work a piece of code does, measured in CPU instructions. This gives much
+ * more consistent results than timing the code. For example:
+ *
+ *     EXPECT_INSTRUCTIONS_BELOW(lexicon.contains("quokka"), 10000);
+ *
+ * checks that the lookup takes fewer than 10,000 instructions, and
+ *
+ *     EXPECT_COST_RATIO_BELOW(studentSort(v1), referenceSort(v2), 2.0);
+ *
+ * checks that the first expression takes less than twice the instructions of the second.
+ * Ratios hold up better than absolute limits across machines and compilers.
+ *
+ * If the grading machine doesn't allow access to the CPU's counters, instructions are
+ * estimated from CPU time, which is far noisier; the driver log says which was used. To
+ * check other properties, MEASURE_COST returns a Cost (see TestCost.h) that includes cache
+ * and branch misses where the CPU reports them:
+ *
+ *     Cost cost = MEASURE_COST(matrix.transpose());
+ *     if (cost.hasMissCounts) EXPECT(cost.cacheMisses < 1000);
+ */
+#define EXPECT_INSTRUCTIONS_BELOW(expression, limit)          /* Something internal you shouldn't worry about. */
+#define EXPECT_COST_RATIO_BELOW(expression, reference, ratio) /* Something internal you shouldn't worry about. */
+#define MEASURE_COST(expression)                              /* Something internal you shouldn't worry about. */
+
+/* Checks how code uses memory. EXPECT_NO_LEAKS checks that evaluating an expression leaves
+ * no more memory in use than before, and EXPECT_MAX_ALLOCATIONS checks that it allocates
+ * at most a given number of blocks. For example:
+ *
+ *    EXPECT_NO_LEAKS(fillThenClear(list));
+ *    EXPECT_MAX_ALLOCATIONS(Stack(std::move(original)), 0);
+ *
+ * For finer-grained checks, an AllocationCounter (see TestAllocations.h) counts everything
+ * allocated during its lifetime. Allocations are only tracked while a test is running.
+ */
+#define EXPECT_NO_LEAKS(expression)               /* Something internal you shouldn't worry about. */
+#define EXPECT_MAX_ALLOCATIONS(expression, limit) /* Something internal you shouldn't worry about. */
+
+/* Checks a function against a reference implementation by calling both on many randomly
+ * generated inputs and making sure they return the same thing (or both throw). If they ever
+ * disagree, the input is shrunk down to a small one they still disagree on, and the test
+ * fails with that input and the random seed used, so the failure can be reproduced with
+ * run-tests --property-seed. For example:
+ *
+ *    CHECK_AGAINST_REFERENCE(studentSort, referenceSort, Gen::vectorsOf(Gen::integers(-50, 50)));
+ *
+ * For functions of several arguments, generate tuples with Gen::tuplesOf. See TestProperty.h
+ * for the available generators and how to write your own, and TestFormatting.h for how to
+ * control the way values are printed.
+ */
+#define CHECK_AGAINST_REFERENCE(function, reference, generator) /* Something internal you shouldn't worry about. */
+
+/* Checks what a piece of code prints to stdout against a file of the output it should print.
+ * If they differ, the test fails, showing the student the first line that's different along
+ * with the lines just before it. For example:
+ *
+ *    EXPECT_OUTPUT_MATCHES_FILE(printCalendar(2024), "calendar-2024.txt");
+ *
+ * By default the output has to match exactly. To be more forgiving, pass a third argument:
+ *
+ *    EXPECT_OUTPUT_MATCHES_FILE(printTable(data), "table.txt", Compare::ignoringWhitespace());
+ *    EXPECT_OUTPUT_MATCHES_FILE(simulate(planets), "orbits.txt", Compare::withTolerance(1e-6));
+ *
+ * The output is compared as it's printed rather than being saved up first, so this works
+ * well even for code that prints a lot. See TestGoldenFile.h for the details.
+ */
+#define EXPECT_OUTPUT_MATCHES_FILE(expression, filename, optionalComparison) /* Something internal you shouldn't worry about. */
+
+/* Checks that parallel code gets faster when given more threads. The first argument is a
+ * function that does a fixed amount of work using however many threads it's told to. It's
+ * timed with one thread, then two, four, and so on up to the given number of threads, and
+ * the test fails if the last of those isn't at least the given number of times as fast as
+ * the first. For example:
+ *
+ *    ADD_TIMING_SENSITIVE_TEST("Parallel sum scales") {
+ *       EXPECT_SPEEDUP([&](std::size_t threads) { parallelSum(data, threads); }, 8, 4.0);
+ *    }
+ *
+ * checks that eight threads sum the data at least four times as fast as one. If the machine
+ * has fewer CPUs than that, the required speedup is scaled down to match. Use this in a
+ * timing-sensitive test, which runs with no other tests running; the speedup test then gets
+ * every CPU to itself. Timings for each thread count go in the driver log.
+ *
+ * To test code that uses threads, see TestConcurrency.h. It has runInParallel, which runs
+ * test code on several threads with EXPECT and FAIL_TEST working as usual on all of them,
+ * and stressConcurrently, which hammers a concurrent data structure from many threads and
+ * then checks it's still intact.
+ */
+#define EXPECT_SPEEDUP(workload, maxThreads, minSpeedup) /* Something internal you shouldn't worry about. */
+
+/* Marks the end of one phase of a long test. If the test times out or crashes, the result
+ * says which checkpoint it reached last. By adding AWARD_PARTIAL_CREDIT at the start of a
+ * test, saying how many checkpoints it has, a test that's cut short also earns that fraction
+ * of its points. For example:
+ *
+ *    ADD_TEST("Handles a huge dictionary", 10) {
+ *       AWARD_PARTIAL_CREDIT(3);
+ *       Lexicon english("EnglishWords.txt");
+ *       CHECKPOINT("Loaded all the words");
+ *       ...
+ *       CHECKPOINT("Found every anagram");
+ *       ...
+ *       CHECKPOINT("Removed every word");
+ *    }
+ *
+ * A test that passes gets all its points and a test that fails outright gets none, no
+ * matter how many checkpoints it reached. Credit goes by how many differently named
+ * checkpoints the test reached, so a CHECKPOINT in a loop counts once, however many times
+ * it runs, and checkpoints are cheap enough to use there. Partial credit is in whole
+ * points, so a test can't have more checkpoints than points.
+ */
+#define CHECKPOINT(phase)                     /* Something internal you shouldn't worry about. */
+#define AWARD_PARTIAL_CREDIT(numCheckpoints)  /* Something internal you shouldn't worry about. */
+
 /* Immediately signals that a test has ended with the stated result.
  *
  *    for (auto elem: list) {
@@ -63,6 +205,18 @@
  */
 #define ADD_TEST(description) /* Something internal you shouldn't worry about. */
 
+/* Defines a new test case whose result depends on how long things take, such as a test
+ * that checks that an operation is fast enough. It works just like ADD_TEST:
+ *
+ *    ADD_TIMING_SENSITIVE_TEST("Lookups are fast", 5) {
+ *       ... your testing code goes here ...
+ *    }
+ *
+ * Tests are normally run several at a time, which makes timings unreliable. A timing-
+ * sensitive test is instead run with no other tests running, on a CPU of its own.
+ */
+#define ADD_TIMING_SENSITIVE_TEST(description) /* Something internal you shouldn't worry about. */
+
 /* Defines a new test group. Each test case you define should be written as
  *
  *    TEST_GROUP("Equivalence Relation Tests") {
@@ -91,6 +245,30 @@
  */
 #define MAKE_TESTS_PUBLIC() /* Something internal you shouldn't worry about. */
 
+/* Marks every test in the current group as timing-sensitive, as if each one had been
+ * defined with ADD_TIMING_SENSITIVE_TEST. For example:
+ *
+ *    TEST_GROUP("Efficiency Tests") {
+ *       MAKE_TESTS_TIMING_SENSITIVE();
+ *       ...
+ *    }
+ */
+#define MAKE_TESTS_TIMING_SENSITIVE() /* Something internal you shouldn't worry about. */
+
+/* Gives every test in the current group a private copy of the test data to work in, for
+ * tests that create, change, or delete files. For example:
+ *
+ *    TEST_GROUP("File Writing Tests") {
+ *       GIVE_TESTS_SCRATCH_SPACE();
+ *       ...
+ *    }
+ *
+ * Other tests all run in one shared, read-only copy of the test data, which costs nothing
+ * per test. Making a private copy means copying the whole data set for each test, so only
+ * ask for this where it's needed. See TestScratch.h for the details.
+ */
+#define GIVE_TESTS_SCRATCH_SPACE() /* Something internal you shouldn't worry about. */
+
 /* Requires that the named file be submitted in order for the given test group to run.
  * If that file isn't submitted, the tests in the section won't be run and the student
  * will see an error message indicating this.
@@ -99,6 +277,33 @@
  */
 #define REQUIRE_SUBMITTED_FILE(filename) /* Something internal you shouldn't worry about. */
 
+/* Defines a fixture, a piece of state shared by all the tests in a test group, which is
+ * handy when that state is expensive to build. For example:
+ *
+ *    TEST_GROUP("Dictionary Tests") {
+ *       GROUP_FIXTURE(Lexicon, english) {
+ *          return Lexicon("EnglishWords.txt");
+ *       }
+ *
+ *       ADD_TEST("Finds common words") {
+ *          EXPECT(english().contains("quokka"));
+ *       }
+ *    }
+ *
+ * The fixture is built once, before any tests run, and each test then gets its own private
+ * copy, so changes one test makes aren't seen by any other. Tests from different groups run
+ * side by side, so every group's fixtures are built up front and kept until all the tests
+ * are done; keep that in mind if a fixture is very large. Fixtures are built inside the
+ * test driver itself, so they shouldn't call student code.
+ *
+ * If building a fixture throws an exception, crashes, or takes longer than the default
+ * test timeout, none of the tests in the group will be run and the group will report that
+ * its setup failed. A crash can still leave the driver in a bad state, which is one more
+ * reason to keep student code out of fixtures. If the type has a comma in it, such as
+ * std::map<std::string, int>, give it a name with a using declaration first.
+ */
+#define GROUP_FIXTURE(type, name) /* Something internal you shouldn't worry about. */
+
 
 
 
@@ -109,6 +314,13 @@
 /*********************************************************************************************/
 
 #include "Test.h"
+#include "TestCost.h"
+#include "TestAllocations.h"
+#include "TestProperty.h"
+#include "TestCheckpoint.h"
+#include "TestGoldenFile.h"
+#include "TestConcurrency.h"
+#include "TestComparison.h"
 #include <vector>
 #include <string>
 #include <memory>
@@ -158,6 +370,92 @@ private:
 #define EXPECT(condition) doExpect(condition, "expect(" #condition "): condition was false.", __LINE__, __FILE__)
 void doExpect(bool condition, const char* expression, std::size_t line, const char* filename);
 
+#undef EXPECT_EQ
+#define EXPECT_EQ(lhs, rhs)                                                   \
+    doExpectEqual(lhs, rhs, "expect_eq(" #lhs ", " #rhs ")", __LINE__, __FILE__)
+
+#undef EXPECT_LT
+#define EXPECT_LT(lhs, rhs)                                                   \
+    doExpectLess(lhs, rhs, "expect_lt(" #lhs ", " #rhs ")", __LINE__, __FILE__)
+
+#undef EXPECT_NEAR
+#define EXPECT_NEAR(lhs, rhs, tolerance)                                      \
+    doExpectNear(lhs, rhs, tolerance, "expect_near(" #lhs ", " #rhs ", " #tolerance ")", \
+                 __LINE__, __FILE__)
+
+#undef EXPECT_RANGE_EQ
+#define EXPECT_RANGE_EQ(lhs, rhs)                                             \
+    doExpectRangeEqual(lhs, rhs, "expect_range_eq(" #lhs ", " #rhs ")", __LINE__, __FILE__)
+
+#undef EXPECT_RANGE_NEAR
+#define EXPECT_RANGE_NEAR(lhs, rhs, tolerance)                                \
+    doExpectRangeNear(lhs, rhs, tolerance,                                    \
+                      "expect_range_near(" #lhs ", " #rhs ", " #tolerance ")", __LINE__, __FILE__)
+
+#undef MEASURE_COST
+#define MEASURE_COST(expression) measureCost([&] { (void)(expression); })
+
+#undef EXPECT_INSTRUCTIONS_BELOW
+#define EXPECT_INSTRUCTIONS_BELOW(expression, limit)                          \
+    doExpectInstructionsBelow(MEASURE_COST(expression), limit,                \
+                              #expression, __LINE__, __FILE__)
+void doExpectInstructionsBelow(const Cost& cost, std::uint64_t limit, const char* expression,
+                               std::size_t line, const char* filename);
+
+#undef EXPECT_NO_LEAKS
+#define EXPECT_NO_LEAKS(expression)                                           \
+    doExpectNoLeaks([&] { (void)(expression); }, #expression, __LINE__, __FILE__)
+void doExpectNoLeaks(const std::function<void ()>& code, const char* expression,
+                     std::size_t line, const char* filename);
+
+#undef EXPECT_MAX_ALLOCATIONS
+#define EXPECT_MAX_ALLOCATIONS(expression, limit)                             \
+    doExpectMaxAllocations([&] { (void)(expression); }, limit, #expression, __LINE__, __FILE__)
+void doExpectMaxAllocations(const std::function<void ()>& code, std::uint64_t limit,
+                            const char* expression, std::size_t line, const char* filename);
+
+#undef EXPECT_COST_RATIO_BELOW
+#define EXPECT_COST_RATIO_BELOW(expression, reference, ratio)                 \
+    doExpectCostRatioBelow([&] { (void)(expression); }, [&] { (void)(reference); }, \
+                           ratio, #expression, #reference, __LINE__, __FILE__)
+void doExpectCostRatioBelow(const std::function<void ()>& code,
+                            const std::function<void ()>& reference, double ratio,
+                            const char* expression, const char* referenceExpression,
+                            std::size_t line, const char* filename);
+
+#undef CHECKPOINT
+#define CHECKPOINT(phase) reachCheckpoint(phase)
+
+#undef AWARD_PARTIAL_CREDIT
+#define AWARD_PARTIAL_CREDIT(numCheckpoints) expectCheckpoints(numCheckpoints)
+
+#undef CHECK_AGAINST_REFERENCE
+#define CHECK_AGAINST_REFERENCE(function, reference, generator)               \
+    doCheckAgainstReference(function, reference, generator, __LINE__, __FILE__)
+
+#undef EXPECT_OUTPUT_MATCHES_FILE
+#define EXPECT_OUTPUT_MATCHES_FILE_MACRO(_1, _2, _3, NAME, ...) NAME
+#define EXPECT_OUTPUT_MATCHES_FILE(...)                                       \
+    EXPECT_OUTPUT_MATCHES_FILE_MACRO(__VA_ARGS__, EXPECT_OUTPUT_MATCHES_FILE_USING, \
+                                     EXPECT_OUTPUT_MATCHES_FILE_EXACTLY, X)(__VA_ARGS__)
+
+#define EXPECT_OUTPUT_MATCHES_FILE_EXACTLY(expression, filename)              \
+    EXPECT_OUTPUT_MATCHES_FILE_USING(expression, filename, Compare::exactly())
+
+#define EXPECT_OUTPUT_MATCHES_FILE_USING(expression, filename, comparison)    \
+    doExpectOutputMatchesFile([&] { (void)(expression); }, filename, comparison, \
+                              #expression, __LINE__, __FILE__)
+void doExpectOutputMatchesFile(const std::function<void ()>& code, const std::string& goldenFile,
+                               const OutputComparison& comparison, const char* expression,
+                               std::size_t line, const char* filename);
+
+#undef EXPECT_SPEEDUP
+#define EXPECT_SPEEDUP(workload, maxThreads, minSpeedup)                      \
+    doExpectSpeedup(workload, maxThreads, minSpeedup, #workload, __LINE__, __FILE__)
+void doExpectSpeedup(const std::function<void (std::size_t)>& workload, std::size_t maxThreads,
+                     double minSpeedup, const char* expression,
+                     std::size_t line, const char* filename);
+
 /* Bogus return type used for initialization of test cases. */
 
 /* Root testing group. */
@@ -209,7 +507,8 @@ namespace Parent = Root;
       }                                                                             \
                                                                                     \
       auto _thisGroup =                                                             \
-        Parent::installTest({}, std::make_shared<TestGroup>(groupName, numPoints)); \
+        Parent::installTest({}, std::make_shared<TestGroup>(groupName, numPoints,   \
+                                                            sourceFileName(__FILE__))); \
                                                                                     \
       namespace Contents {                                                          \
         namespace Parent = JOIN3(group, _TestGroup_, line);                         \
@@ -236,13 +535,33 @@ namespace Parent = Root;
     DO_ADD_TEST(name, 1, GROUP, __LINE__)
 
 #define DO_ADD_TEST(name, points, group, line)                                \
+    DO_ADD_TEST_OF_KIND(name, points, false, group, line)
+
+#define DO_ADD_TEST_OF_KIND(name, points, timingSensitive, group, line)       \
     void JOIN3(group, _TestFunction_, line)();                                \
     auto JOIN3(_installer, _dummy_, line) =                                   \
       Parent::installTest({},                                                 \
                           std::make_shared<TestCase>(name,                    \
-                          JOIN3(group, _TestFunction_, line), points));       \
+                          JOIN3(group, _TestFunction_, line), points,         \
+                          timingSensitive));                                  \
     void JOIN3(group, _TestFunction_, line)()
 
+/* Macro: ADD_TIMING_SENSITIVE_TEST(name) {
+ *    ...
+ * }
+ *
+ * What it actually does: the same as ADD_TEST, except that it flags the test case.
+ */
+#undef  ADD_TIMING_SENSITIVE_TEST
+
+#define ADD_TIMING_SENSITIVE_TEST(...) ADD_TEST_MACRO(__VA_ARGS__, ADD_NEW_TIMING_SENSITIVE_TEST, ADD_NEW_TIMING_SENSITIVE_TEST_DEFAULT, X)(__VA_ARGS__)
+
+#define ADD_NEW_TIMING_SENSITIVE_TEST(name, numPoints)                        \
+    DO_ADD_TEST_OF_KIND(name, numPoints, true, GROUP, __LINE__)
+
+#define ADD_NEW_TIMING_SENSITIVE_TEST_DEFAULT(name)                           \
+    DO_ADD_TEST_OF_KIND(name, 1, true, GROUP, __LINE__)
+
 #define JOIN2(first, second) first##second
 #define JOIN3(first, second, third) first##second##third
 
@@ -259,6 +578,30 @@ namespace Parent = Root;
       std::static_pointer_cast<TestGroup>(_thisGroup)->setPublic();           \
     })
     
+/* Macro: MAKE_TESTS_TIMING_SENSITIVE
+ *
+ * What it actually does: Flags the current group, found as in MAKE_TESTS_PUBLIC.
+ */
+#undef  MAKE_TESTS_TIMING_SENSITIVE
+#define MAKE_TESTS_TIMING_SENSITIVE() DO_MAKE_TESTS_TIMING_SENSITIVE(__LINE__)
+
+#define DO_MAKE_TESTS_TIMING_SENSITIVE(line)                                  \
+    Invoker JOIN2(_temp_timing_invoker_, line)([] {                           \
+      std::static_pointer_cast<TestGroup>(_thisGroup)->setTimingSensitive();  \
+    })
+    
+/* Macro: GIVE_TESTS_SCRATCH_SPACE
+ *
+ * What it actually does: Flags the current group, found as in MAKE_TESTS_PUBLIC.
+ */
+#undef  GIVE_TESTS_SCRATCH_SPACE
+#define GIVE_TESTS_SCRATCH_SPACE() DO_GIVE_TESTS_SCRATCH_SPACE(__LINE__)
+
+#define DO_GIVE_TESTS_SCRATCH_SPACE(line)                                     \
+    Invoker JOIN2(_temp_scratch_invoker_, line)([] {                          \
+      std::static_pointer_cast<TestGroup>(_thisGroup)->giveTestsScratch();    \
+    })
+    
 /* Macro: REQUIRE_SUBMITTED_FILE
  *
  * What it actually does: Uses scope resolution to select the right test group,
@@ -273,4 +616,46 @@ namespace Parent = Root;
     })
 
 
+/* Macro: GROUP_FIXTURE(type, name) {
+ *    ...
+ * }
+ *
+ * What it actually does: prototypes a function that builds the fixture, declares an
+ * object that registers itself with the current group (found by scope resolution, as
+ * with MAKE_TESTS_PUBLIC), and then defines that function.
+ */
+#undef  GROUP_FIXTURE
+#define GROUP_FIXTURE(type, name) DO_GROUP_FIXTURE(type, name, GROUP, __LINE__)
+
+#define DO_GROUP_FIXTURE(type, name, group, line)                             \
+    type JOIN3(group, _FixtureFunction_, line)();                             \
+    GroupFixture<type> name(_thisGroup, JOIN3(group, _FixtureFunction_, line)); \
+    type JOIN3(group, _FixtureFunction_, line)()
+
+/* Fixture holding a value of a particular type. */
+template <typename T> class GroupFixture: public Fixture {
+public:
+  GroupFixture(std::shared_ptr<Test> group, std::function<T ()> build) : build(build) {
+    std::static_pointer_cast<TestGroup>(group)->addFixture(this);
+  }
+  
+  /* Accesses the value. This is only available while the group's tests are running. */
+  T& operator()() {
+    if (!value) doInternalError("Fixture used outside of its test group.", __LINE__, __FILE__);
+    return *value;
+  }
+  
+  void setUp() override {
+    value = std::make_unique<T>(build());
+  }
+  
+  void tearDown() override {
+    value.reset();
+  }
+  
+private:
+  std::function<T ()> build;
+  std::unique_ptr<T>  value;
+};
+
 #endif
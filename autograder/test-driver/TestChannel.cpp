@@ -0,0 +1,97 @@
+#include "TestChannel.h"
+#include "TestCommon.h"
+#include <unistd.h>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+using namespace std;
+
+namespace {
+  /* Size of the header at the start of each record. */
+  const size_t kHeaderSize = sizeof(uint8_t) + sizeof(uint32_t);
+
+  /* How many bytes to try reading from the channel at once. */
+  const size_t kBufferSize = 4096;
+
+  /* Where logToDriver() writes, or -1 if there's no channel. */
+  int driverFD = -1;
+
+  /* Writes the full contents of a buffer, retrying on short writes and interrupts. */
+  bool writeFully(int fd, const char* data, size_t length) {
+    while (length != 0) {
+      auto written = write(fd, data, length);
+      if (written == -1) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+
+      data   += written;
+      length -= written;
+    }
+    return true;
+  }
+}
+
+bool writeRecord(int fd, RecordType type, const void* data, size_t length) {
+  char header[kHeaderSize];
+  header[0] = static_cast<char>(type);
+
+  uint32_t size = length;
+  memcpy(header + 1, &size, sizeof(size));
+
+  /* Small records get assembled and written in one go so that they're atomic. */
+  if (kHeaderSize + length <= PIPE_BUF) {
+    char record[PIPE_BUF];
+    memcpy(record, header, kHeaderSize);
+    memcpy(record + kHeaderSize, data, length);
+    return writeFully(fd, record, kHeaderSize + length);
+  }
+
+  return writeFully(fd, header, kHeaderSize) &&
+         writeFully(fd, static_cast<const char*>(data), length);
+}
+
+bool writeRecord(int fd, RecordType type, const string& payload) {
+  return writeRecord(fd, type, payload.data(), payload.size());
+}
+
+void setDriverChannel(int fd) {
+  driverFD = fd;
+}
+
+void logToDriver(const string& text) {
+  if (driverFD == -1) {
+    cout << text << endl;
+  } else if (!writeRecord(driverFD, RecordType::LOG, text + "\n")) {
+    emergencyAbort("Couldn't write data across pipe.");
+  }
+}
+
+/* * * * * RecordReader Implementation * * * * */
+bool RecordReader::readFrom(int fd) {
+  char data[kBufferSize];
+
+  ssize_t bytes;
+  do {
+    bytes = read(fd, data, kBufferSize);
+  } while (bytes == -1 && errno == EINTR);
+
+  if (bytes == -1) emergencyAbort("Error reading from child process.");
+
+  buffer.append(data, bytes);
+  return bytes != 0;
+}
+
+bool RecordReader::next(RecordType& type, string& payload) {
+  if (buffer.size() < kHeaderSize) return false;
+
+  uint32_t length;
+  memcpy(&length, buffer.data() + 1, sizeof(length));
+  if (buffer.size() < kHeaderSize + length) return false;
+
+  type    = static_cast<RecordType>(buffer[0]);
+  payload = buffer.substr(kHeaderSize, length);
+  buffer.erase(0, kHeaderSize + length);
+  return true;
+}
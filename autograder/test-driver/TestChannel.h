@@ -0,0 +1,53 @@
+/* Functions and types for the channel a test's child process uses to report back to the
+ * test driver. Everything the child sends is broken into records, each of which consists of
+ * a one-byte record type, a four-byte length, and then that many bytes of payload.
+ */
+
+#ifndef TestChannel_Included
+#define TestChannel_Included
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/* Type of a record sent across the channel. */
+enum class RecordType: std::uint8_t {
+  RESULT,     // How the test went: an XOR-coded Result byte, followed by the message.
+  BACKTRACE,  // Where one thread was when asked: its thread ID, then raw return addresses.
+  LOG,        // Text for the driver log.
+  CHECKPOINT, // How far the test got: the XOR key, checkpoints reached, total, then the name.
+};
+
+/* Writes a record to the given file descriptor, returning whether it succeeded. This is
+ * async-signal-safe. Records whose total size is at most PIPE_BUF are written with a single
+ * call to write(), so records sent from different threads won't interleave.
+ */
+bool writeRecord(int fd, RecordType type, const void* data, std::size_t length);
+bool writeRecord(int fd, RecordType type, const std::string& payload);
+
+/* Sets where logToDriver() sends its records. The child process calls this once it knows
+ * which descriptor it's using to talk to the driver.
+ */
+void setDriverChannel(int fd);
+
+/* Sends a line of text for the driver log. Outside of a child process, where there's no
+ * channel, the text is printed directly.
+ */
+void logToDriver(const std::string& text);
+
+/* Type that reassembles records out of the bytes read from a channel. */
+class RecordReader {
+public:
+  /* Reads whatever data is available from the given file descriptor. Returns whether
+   * any data was read, with false indicating end-of-file.
+   */
+  bool readFrom(int fd);
+
+  /* Extracts the next complete record, if there is one. */
+  bool next(RecordType& type, std::string& payload);
+
+private:
+  std::string buffer;
+};
+
+#endif
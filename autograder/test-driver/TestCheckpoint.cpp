@@ -0,0 +1,175 @@
+#include "TestCheckpoint.h"
+#include "TestChannel.h"
+#include "TestCommon.h"
+#include "TestCase.h"
+#include <signal.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <limits>
+#include <set>
+using namespace std;
+
+namespace {
+  /* How often to send checkpoints, in nanoseconds. Anything in between is held on to and
+   * sent later if needed.
+   */
+  const int64_t kSendInterval = 20 * 1000 * 1000; // 20ms
+
+  /* Longest phase name we keep. Longer names are truncated. */
+  const size_t kMaxPhaseLength = 256;
+
+  /* Signals that cause us to send the last checkpoint before dying. Under AddressSanitizer,
+   * we leave crashes to it so that it can report them.
+   */
+#ifndef __SANITIZE_ADDRESS__
+  const int kFinalSignals[] = { SIGTERM, SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+#else
+  const int kFinalSignals[] = { SIGTERM };
+#endif
+
+  /* Everything the signal handlers need is kept in fixed-size storage, since they can't
+   * allocate. A CHECKPOINT record is the key, the number reached, the total, and the name.
+   */
+  struct Snapshot {
+    uint32_t reached;
+    uint32_t total;
+    size_t   length;
+    char     phase[kMaxPhaseLength];
+  };
+  const size_t kHeaderLength = sizeof(uint8_t) + 2 * sizeof(uint32_t);
+
+  int     checkpointFD = -1;
+  uint8_t checkpointKey;
+
+  /* Checkpoints are written into whichever snapshot isn't current, then published by
+   * flipping the index, so a signal handler never sees one that's half-written.
+   */
+  Snapshot snapshots[2];
+  atomic<int>  current{0};
+  atomic<bool> unsent{false};
+  mutex        writerLock;
+
+  int64_t lastSend = 0;
+
+  /* Names of the checkpoints reached so far, so that reaching one again doesn't count. */
+  set<string> phasesReached;
+
+  /* Most checkpoints the test running on this thread may ask for. */
+  thread_local size_t checkpointLimit = numeric_limits<size_t>::max();
+
+  int64_t now() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+  }
+
+  /* Sends the current snapshot. This is async-signal-safe. */
+  void sendSnapshot() {
+    const Snapshot& snapshot = snapshots[current.load()];
+
+    char payload[kHeaderLength + kMaxPhaseLength];
+    payload[0] = checkpointKey;
+    memcpy(payload + 1, &snapshot.reached, sizeof(uint32_t));
+    memcpy(payload + 1 + sizeof(uint32_t), &snapshot.total, sizeof(uint32_t));
+    memcpy(payload + kHeaderLength, snapshot.phase, snapshot.length);
+
+    unsent = false;
+    writeRecord(checkpointFD, RecordType::CHECKPOINT, payload, kHeaderLength + snapshot.length);
+  }
+
+  /* Publishes a new snapshot built from the current one, sending it if it's been long
+   * enough since the last one went out.
+   */
+  template <typename Change> void update(Change change) {
+    lock_guard<mutex> lock(writerLock);
+
+    int next = 1 - current.load();
+    snapshots[next] = snapshots[current.load()];
+    change(snapshots[next]);
+    current = next;
+    unsent  = true;
+
+    auto time = now();
+    if (time - lastSend >= kSendInterval) {
+      lastSend = time;
+      sendSnapshot();
+    }
+  }
+
+  /* Sends anything not yet sent, then lets the signal do what it was going to do. The
+   * handler is reset on entry, so raising the signal again delivers it for real as soon as
+   * the handler finishes. That matters for crash signals too: one sent with raise() or
+   * kill() rather than by a fault wouldn't happen again on its own, and the test would
+   * carry on as if nothing had happened.
+   */
+  void finalCheckpointHandler(int signal) {
+    int savedErrno = errno;
+    if (unsent) sendSnapshot();
+    raise(signal);
+    errno = savedErrno;
+  }
+}
+
+void installCheckpointHandlers(int fd, uint8_t key) {
+  checkpointFD  = fd;
+  checkpointKey = key;
+
+  for (int signal: kFinalSignals) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = finalCheckpointHandler;
+    action.sa_flags   = SA_ONSTACK | SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(signal, &action, nullptr) == -1) emergencyAbort("sigaction() failed.");
+  }
+}
+
+void reachCheckpoint(const string& phase) {
+  if (checkpointFD == -1) {
+    logToDriver("  Reached checkpoint: " + phase);
+    return;
+  }
+
+  update([&](Snapshot& snapshot) {
+    if (phasesReached.insert(phase).second) snapshot.reached++;
+    snapshot.length = min(phase.size(), kMaxPhaseLength);
+    memcpy(snapshot.phase, phase.data(), snapshot.length);
+  });
+}
+
+void limitCheckpoints(size_t maxTotal) {
+  checkpointLimit = maxTotal;
+}
+
+void expectCheckpoints(size_t total) {
+  if (total > checkpointLimit) {
+    doInternalError("AWARD_PARTIAL_CREDIT(" + to_string(total) + ") asks for more checkpoints than the test has "
+                    "points (" + to_string(checkpointLimit) + "), but partial credit is in whole points.",
+                    __LINE__, __FILE__);
+  }
+  if (checkpointFD == -1) {
+    logToDriver("  Expecting " + to_string(total) + " checkpoints. (Partial credit isn't awarded without a child process.)");
+    return;
+  }
+
+  update([&](Snapshot& snapshot) {
+    snapshot.total = total;
+  });
+}
+
+bool decodeCheckpoint(const string& payload, uint8_t key, CheckpointProgress& progress) {
+  if (payload.size() < kHeaderLength || uint8_t(payload[0]) != key) return false;
+
+  uint32_t reached, total;
+  memcpy(&reached, payload.data() + 1, sizeof(reached));
+  memcpy(&total,   payload.data() + 1 + sizeof(uint32_t), sizeof(total));
+
+  progress.reached = reached;
+  progress.total   = total;
+  progress.phase   = payload.substr(kHeaderLength);
+  return true;
+}
@@ -0,0 +1,54 @@
+/* Functions for reporting how far a test got before it was cut short. A test marks the end of
+ * each phase with a checkpoint, and the child process passes the most recent one along to
+ * the driver, so a test that times out or crashes can report the last phase it finished
+ * and, if it asks for it, earn credit in proportion to how far it got.
+ *
+ * Checkpoints are cheap enough to hit in a loop: the child only sends one every so often,
+ * plus a final one when it's told to terminate or when it crashes. Progress is counted in
+ * distinct checkpoint names, so hitting the same one over and over counts only once.
+ */
+
+#ifndef TestCheckpoint_Included
+#define TestCheckpoint_Included
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/* How far a test got. */
+struct CheckpointProgress {
+  std::size_t reached = 0; // How many different checkpoints the test passed
+  std::size_t total   = 0; // How many it has, or zero if it doesn't want partial credit
+  std::string phase;       // Name of the most recent one
+};
+
+/* Sets up the current (child) process to send checkpoints to the given file descriptor,
+ * marked with the given key. This installs handlers that send the last checkpoint on
+ * SIGTERM and on crashes, so it needs to come after installStackDumpHandler(), which sets
+ * up the stack those handlers run on.
+ */
+void installCheckpointHandlers(int fd, std::uint8_t key);
+
+/* Records that the running test finished the named phase. Reaching a phase it already
+ * reached doesn't count as progress. Outside of a child process, the checkpoint is just
+ * logged.
+ */
+void reachCheckpoint(const std::string& phase);
+
+/* Sets the most checkpoints the next test run on this thread can ask for. Partial credit is
+ * awarded in whole points, so a test can't have more checkpoints than it has points.
+ */
+void limitCheckpoints(std::size_t maxTotal);
+
+/* Records that the running test has the given number of checkpoints in total, and should
+ * get partial credit for the ones it reaches if it times out or crashes. Asking for more
+ * than the limit is an internal error.
+ */
+void expectCheckpoints(std::size_t total);
+
+/* Given the payload of a CHECKPOINT record, fills in the progress it describes. Returns
+ * false if the record wasn't sent by the test framework.
+ */
+bool decodeCheckpoint(const std::string& payload, std::uint8_t key, CheckpointProgress& progress);
+
+#endif
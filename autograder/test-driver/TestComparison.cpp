@@ -0,0 +1,97 @@
+#include "TestComparison.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+#ifdef __SSE2__
+
+namespace {
+  /* The handful of SSE2 operations the kernels need, for each element type. Every x86-64
+   * processor has these, so nothing here depends on how the tests were compiled.
+   */
+  struct DoubleLanes {
+    using Vector = __m128d;
+    static constexpr size_t kWidth = 2;
+
+    static Vector load(const double* where)     { return _mm_loadu_pd(where); }
+    static Vector splat(double value)           { return _mm_set1_pd(value); }
+    static Vector minus(Vector lhs, Vector rhs) { return _mm_sub_pd(lhs, rhs); }
+    static Vector atMost(Vector lhs, Vector rhs) { return _mm_cmple_pd(lhs, rhs); }
+    static Vector same(Vector lhs, Vector rhs)  { return _mm_cmpeq_pd(lhs, rhs); }
+    static Vector both(Vector lhs, Vector rhs)  { return _mm_and_pd(lhs, rhs); }
+    static bool   allSet(Vector mask)           { return _mm_movemask_pd(mask) == 0x3; }
+  };
+
+  struct FloatLanes {
+    using Vector = __m128;
+    static constexpr size_t kWidth = 4;
+
+    static Vector load(const float* where)      { return _mm_loadu_ps(where); }
+    static Vector splat(float value)            { return _mm_set1_ps(value); }
+    static Vector minus(Vector lhs, Vector rhs) { return _mm_sub_ps(lhs, rhs); }
+    static Vector atMost(Vector lhs, Vector rhs) { return _mm_cmple_ps(lhs, rhs); }
+    static Vector same(Vector lhs, Vector rhs)  { return _mm_cmpeq_ps(lhs, rhs); }
+    static Vector both(Vector lhs, Vector rhs)  { return _mm_and_ps(lhs, rhs); }
+    static bool   allSet(Vector mask)           { return _mm_movemask_ps(mask) == 0xF; }
+  };
+
+  /* Skips over whole blocks in which every pair of elements matches, stopping at the first
+   * block that has a pair that doesn't. Like the scalar version, a block is checked all the
+   * way through before deciding anything. Comparisons are written so that NaN never matches.
+   */
+  template <typename Lanes, bool kNear, typename T>
+  size_t skipMatchingBlocks(const T* lhs, const T* rhs, size_t size, T tolerance) {
+    using TestComparisonDetail::kRangeBlock;
+    static_assert(kRangeBlock % Lanes::kWidth == 0, "Blocks must be whole vectors.");
+
+    auto limit = Lanes::splat(tolerance);
+    size_t i = 0;
+    for (; i + kRangeBlock <= size; i += kRangeBlock) {
+      auto matches = Lanes::same(Lanes::splat(0), Lanes::splat(0));
+      for (size_t j = 0; j < kRangeBlock; j += Lanes::kWidth) {
+        auto x = Lanes::load(lhs + i + j);
+        auto y = Lanes::load(rhs + i + j);
+        if constexpr (kNear) {
+          matches = Lanes::both(matches, Lanes::both(Lanes::atMost(Lanes::minus(x, y), limit),
+                                                     Lanes::atMost(Lanes::minus(y, x), limit)));
+        } else {
+          matches = Lanes::both(matches, Lanes::same(x, y));
+        }
+      }
+      if (!Lanes::allSet(matches)) break;
+    }
+    return i;
+  }
+}
+
+size_t TestComparisonDetail::skipEqual(const double* lhs, const double* rhs, size_t size) {
+  return skipMatchingBlocks<DoubleLanes, false>(lhs, rhs, size, 0.0);
+}
+size_t TestComparisonDetail::skipEqual(const float* lhs, const float* rhs, size_t size) {
+  return skipMatchingBlocks<FloatLanes, false>(lhs, rhs, size, 0.0f);
+}
+size_t TestComparisonDetail::skipNear(const double* lhs, const double* rhs, size_t size, double tolerance) {
+  return skipMatchingBlocks<DoubleLanes, true>(lhs, rhs, size, tolerance);
+}
+size_t TestComparisonDetail::skipNear(const float* lhs, const float* rhs, size_t size, float tolerance) {
+  return skipMatchingBlocks<FloatLanes, true>(lhs, rhs, size, tolerance);
+}
+
+#else
+
+/* Elsewhere, the generic block loop is the best we have, so the kernels skip nothing. */
+size_t TestComparisonDetail::skipEqual(const double*, const double*, size_t) {
+  return 0;
+}
+size_t TestComparisonDetail::skipEqual(const float*, const float*, size_t) {
+  return 0;
+}
+size_t TestComparisonDetail::skipNear(const double*, const double*, size_t, double) {
+  return 0;
+}
+size_t TestComparisonDetail::skipNear(const float*, const float*, size_t, float) {
+  return 0;
+}
+
+#endif
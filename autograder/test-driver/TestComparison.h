@@ -0,0 +1,256 @@
+/* Implementation of EXPECT_EQ, EXPECT_LT, and EXPECT_NEAR. Each check is an inline template
+ * that does nothing but the comparison itself, so a check that passes costs one branch.
+ * Everything needed to explain a failure - turning the values into text and building the
+ * message - lives in a separate function that's kept out of line and marked as unlikely to
+ * run, so that it doesn't get in the way of the code around a check in a tight loop.
+ *
+ * EXPECT_RANGE_EQ and EXPECT_RANGE_NEAR work the same way over whole arrays. They compare a
+ * block of elements at a time without stopping partway through the block, which is a loop
+ * the compiler can turn into vector instructions, and only search a block element by element
+ * once it's known to hold a difference. Arrays of integers are compared with memcmp, and
+ * arrays of floats and doubles with hand-written SIMD kernels (see TestComparison.cpp), since
+ * compilers don't vectorize floating-point comparisons well for plain x86-64. Counting how
+ * many elements differ is only done for a failure message.
+ */
+
+#ifndef TestComparison_Included
+#define TestComparison_Included
+
+#include "TestFormatting.h"
+#include <string>
+#include <type_traits>
+#include <iterator>
+#include <cstring>
+#include <cstddef>
+
+/* Fails the current test, explaining that the check in expression didn't hold between the
+ * two values (already formatted). The detail, if there is any, is added to the end.
+ */
+[[ noreturn ]] void failComparison(const char* expression, const std::string& lhs,
+                                   const std::string& rhs, const std::string& detail,
+                                   std::size_t line, const char* filename);
+
+namespace TestComparisonDetail {
+  /* Integers of different signedness can't be compared directly without -Wsign-compare
+   * complaining (and the comparison going wrong for negative values), so those are handled
+   * by hand. Everything else uses its own operators.
+   */
+  template <typename T> constexpr bool IsInteger = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+  template <typename A, typename B> constexpr bool MixedSigns =
+    IsInteger<A> && IsInteger<B> && std::is_signed_v<A> != std::is_signed_v<B>;
+
+  template <typename A, typename B> bool equal(const A& lhs, const B& rhs) {
+    if constexpr (MixedSigns<A, B>) {
+      if constexpr (std::is_signed_v<A>) return lhs >= 0 && std::make_unsigned_t<A>(lhs) == rhs;
+      else                               return rhs >= 0 && lhs == std::make_unsigned_t<B>(rhs);
+    } else {
+      return lhs == rhs;
+    }
+  }
+
+  template <typename A, typename B> bool less(const A& lhs, const B& rhs) {
+    if constexpr (MixedSigns<A, B>) {
+      if constexpr (std::is_signed_v<A>) return lhs < 0  || std::make_unsigned_t<A>(lhs) < rhs;
+      else                               return rhs >= 0 && lhs < std::make_unsigned_t<B>(rhs);
+    } else {
+      return lhs < rhs;
+    }
+  }
+
+  /* C strings print as strings, not as pointers. */
+  template <typename T> std::string describe(const T& value) {
+    if constexpr (std::is_convertible_v<const T&, const char*> && !std::is_null_pointer_v<T>) {
+      const char* text = value;
+      return text? formatForTest(std::string(text)) : "nullptr";
+    } else {
+      return formatForTest(value);
+    }
+  }
+
+  template <typename A, typename B>
+  [[ noreturn ]] __attribute__((cold, noinline))
+  void fail(const A& lhs, const B& rhs, const char* expression, std::size_t line, const char* filename) {
+    failComparison(expression, describe(lhs), describe(rhs), "", line, filename);
+  }
+
+  template <typename A, typename B, typename T>
+  [[ noreturn ]] __attribute__((cold, noinline))
+  void failNear(const A& lhs, const B& rhs, const T& tolerance, const char* expression,
+                std::size_t line, const char* filename) {
+    auto difference = lhs < rhs? rhs - lhs : lhs - rhs;
+    failComparison(expression, describe(lhs), describe(rhs),
+                   "; they differ by " + describe(difference) + ", more than " + describe(tolerance),
+                   line, filename);
+  }
+
+  /* Elements per block when comparing ranges. */
+  constexpr std::size_t kRangeBlock = 64;
+
+  /* Index of the first pair of elements that differ, or size if none do. Elements before
+   * start are known to match already.
+   */
+  template <typename A, typename B, typename Differ>
+  std::size_t firstDifference(const A* lhs, const B* rhs, std::size_t size, Differ differ,
+                              std::size_t start = 0) {
+    std::size_t i = start;
+    for (; i + kRangeBlock <= size; i += kRangeBlock) {
+      unsigned any = 0;
+      for (std::size_t j = 0; j < kRangeBlock; j++) {
+        any |= differ(lhs[i + j], rhs[i + j]);
+      }
+      if (any) break;
+    }
+    for (; i < size; i++) {
+      if (differ(lhs[i], rhs[i])) return i;
+    }
+    return size;
+  }
+
+  template <typename A, typename B, typename Differ>
+  std::size_t countDifferences(const A* lhs, const B* rhs, std::size_t size, Differ differ) {
+    std::size_t result = 0;
+    for (std::size_t i = 0; i < size; i++) {
+      result += differ(lhs[i], rhs[i]);
+    }
+    return result;
+  }
+
+  /* SIMD kernels for floating-point ranges. Each returns how many elements at the start of
+   * the ranges are known to be equal, or within the tolerance; the first difference, if
+   * there is one, is somewhere after that.
+   */
+  std::size_t skipEqual(const double* lhs, const double* rhs, std::size_t size);
+  std::size_t skipEqual(const float*  lhs, const float*  rhs, std::size_t size);
+  std::size_t skipNear (const double* lhs, const double* rhs, std::size_t size, double tolerance);
+  std::size_t skipNear (const float*  lhs, const float*  rhs, std::size_t size, float  tolerance);
+
+  template <typename A, typename B> constexpr bool HasKernel =
+    std::is_same_v<A, B> && (std::is_same_v<A, double> || std::is_same_v<A, float>);
+
+  /* Integers of the same type are equal exactly when their bytes are, and memcmp is about as
+   * fast a way to check that as there is.
+   */
+  template <typename A, typename B> constexpr bool ComparesByBytes =
+    std::is_same_v<A, B> && std::is_integral_v<A> && std::has_unique_object_representations_v<A>;
+
+  struct Differs {
+    template <typename A, typename B> bool operator() (const A& lhs, const B& rhs) const {
+      return !equal(lhs, rhs);
+    }
+  };
+
+  /* Floating-point values get a version without branches, which vectorizes better. Either
+   * way, NaN is never close to anything.
+   */
+  template <typename T> struct FarApart {
+    const T& tolerance;
+
+    template <typename A, typename B> bool operator() (const A& lhs, const B& rhs) const {
+      if constexpr (std::is_floating_point_v<A> && std::is_floating_point_v<B>) {
+        return !(lhs - rhs <= tolerance) | !(rhs - lhs <= tolerance);
+      } else {
+        return !(lhs < rhs? rhs - lhs <= tolerance : lhs - rhs <= tolerance);
+      }
+    }
+  };
+
+  [[ noreturn ]] __attribute__((cold, noinline))
+  void failRangeSizes(std::size_t lhs, std::size_t rhs, const char* expression,
+                      std::size_t line, const char* filename);
+
+  template <typename A, typename B, typename Differ>
+  [[ noreturn ]] __attribute__((cold, noinline))
+  void failRange(const A* lhs, const B* rhs, std::size_t size, std::size_t index, Differ differ,
+                 const std::string& why, const char* expression, std::size_t line, const char* filename) {
+    std::size_t count = 1 + countDifferences(lhs + index + 1, rhs + index + 1, size - index - 1, differ);
+    std::string where = std::string(expression) + " at index " + std::to_string(index);
+    failComparison(where.c_str(), describe(lhs[index]), describe(rhs[index]),
+                   why + "; " + std::to_string(count) + " of " + std::to_string(size) + " elements " +
+                   (count == 1? "differs" : "differ"),
+                   line, filename);
+  }
+}
+
+template <typename A, typename B>
+inline void doExpectEqual(const A& lhs, const B& rhs, const char* expression,
+                          std::size_t line, const char* filename) {
+  if (__builtin_expect(!TestComparisonDetail::equal(lhs, rhs), 0)) {
+    TestComparisonDetail::fail(lhs, rhs, expression, line, filename);
+  }
+}
+
+template <typename A, typename B>
+inline void doExpectLess(const A& lhs, const B& rhs, const char* expression,
+                         std::size_t line, const char* filename) {
+  if (__builtin_expect(!TestComparisonDetail::less(lhs, rhs), 0)) {
+    TestComparisonDetail::fail(lhs, rhs, expression, line, filename);
+  }
+}
+
+/* Written so that NaN never counts as near anything. */
+template <typename A, typename B, typename T>
+inline void doExpectNear(const A& lhs, const B& rhs, const T& tolerance, const char* expression,
+                         std::size_t line, const char* filename) {
+  bool near = lhs < rhs? rhs - lhs <= tolerance : lhs - rhs <= tolerance;
+  if (__builtin_expect(!near, 0)) {
+    TestComparisonDetail::failNear(lhs, rhs, tolerance, expression, line, filename);
+  }
+}
+
+template <typename RangeA, typename RangeB>
+inline void doExpectRangeEqual(const RangeA& lhs, const RangeB& rhs, const char* expression,
+                               std::size_t line, const char* filename) {
+  using namespace TestComparisonDetail;
+  std::size_t size = std::size(lhs);
+  if (size != std::size(rhs)) failRangeSizes(size, std::size(rhs), expression, line, filename);
+
+  auto lhsData = std::data(lhs);
+  auto rhsData = std::data(rhs);
+  using A = std::remove_cv_t<std::remove_pointer_t<decltype(lhsData)>>;
+  using B = std::remove_cv_t<std::remove_pointer_t<decltype(rhsData)>>;
+  std::size_t start = 0;
+  if constexpr (ComparesByBytes<A, B>) {
+    if (size == 0 || std::memcmp(lhsData, rhsData, size * sizeof(A)) == 0) return;
+  } else if constexpr (HasKernel<A, B>) {
+    start = skipEqual(lhsData, rhsData, size);
+  }
+
+  std::size_t index = firstDifference(lhsData, rhsData, size, Differs(), start);
+  if (__builtin_expect(index != size, 0)) {
+    failRange(lhsData, rhsData, size, index, Differs(), "", expression, line, filename);
+  }
+}
+
+template <typename RangeA, typename RangeB, typename T>
+inline void doExpectRangeNear(const RangeA& lhs, const RangeB& rhs, const T& tolerance,
+                              const char* expression, std::size_t line, const char* filename) {
+  using namespace TestComparisonDetail;
+  std::size_t size = std::size(lhs);
+  if (size != std::size(rhs)) failRangeSizes(size, std::size(rhs), expression, line, filename);
+
+  auto lhsData = std::data(lhs);
+  auto rhsData = std::data(rhs);
+  using A = std::remove_cv_t<std::remove_pointer_t<decltype(lhsData)>>;
+  using B = std::remove_cv_t<std::remove_pointer_t<decltype(rhsData)>>;
+
+  /* The kernels work in the element type, which gives the same answers only if the
+   * tolerance converts to it exactly.
+   */
+  std::size_t start = 0;
+  if constexpr (HasKernel<A, B> && std::is_arithmetic_v<T>) {
+    if (A(tolerance) == tolerance) start = skipNear(lhsData, rhsData, size, A(tolerance));
+  }
+
+  FarApart<T> farApart{tolerance};
+  std::size_t index = firstDifference(lhsData, rhsData, size, farApart, start);
+  if (__builtin_expect(index != size, 0)) {
+    auto difference = lhsData[index] < rhsData[index]? rhsData[index] - lhsData[index]
+                                                     : lhsData[index] - rhsData[index];
+    failRange(lhsData, rhsData, size, index, farApart,
+              "; they differ by " + describe(difference) + ", more than " + describe(tolerance),
+              expression, line, filename);
+  }
+}
+
+#endif
@@ -0,0 +1,184 @@
+#include "TestConcurrency.h"
+#include "TestCase.h"
+#include "TestChannel.h"
+#include <sched.h>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace {
+  /* How many times to time each thread count. The fastest run is the one used, since
+   * everything that goes wrong while timing only ever makes things slower.
+   */
+  const size_t kSpeedupRuns = 3;
+
+  /* Below this, a single-threaded run is too quick to time reliably. */
+  const chrono::milliseconds kShortestReliableRun(10);
+
+  /* CPUs this process was allowed on before being pinned, if it was pinned. */
+  cpu_set_t availableCPUs;
+  bool      wasPinned = false;
+
+  /* Failure flag for the runInParallel call the current thread is part of, if any. */
+  thread_local const atomic<bool>* currentRunFailed = nullptr;
+
+  /* Lets this process use every CPU it had before being pinned, for as long as it's alive. */
+  class Unpinned {
+  public:
+    Unpinned() {
+      if (!wasPinned || sched_getaffinity(0, sizeof(pinnedCPUs), &pinnedCPUs) == -1) return;
+      restore = (sched_setaffinity(0, sizeof(availableCPUs), &availableCPUs) == 0);
+    }
+
+    ~Unpinned() {
+      if (restore) sched_setaffinity(0, sizeof(pinnedCPUs), &pinnedCPUs);
+    }
+
+  private:
+    cpu_set_t pinnedCPUs;
+    bool restore = false;
+  };
+
+  /* How many CPUs this process can run on. */
+  size_t numUsableCPUs() {
+    cpu_set_t cpus;
+    if (sched_getaffinity(0, sizeof(cpus), &cpus) == -1) {
+      return max<size_t>(1, thread::hardware_concurrency());
+    }
+    return CPU_COUNT(&cpus);
+  }
+
+  /* Thread counts to time: powers of two up to the maximum, then the maximum itself. */
+  vector<size_t> threadCountsUpTo(size_t maxThreads) {
+    vector<size_t> result;
+    for (size_t count = 1; count < maxThreads; count *= 2) {
+      result.push_back(count);
+    }
+    result.push_back(maxThreads);
+    return result;
+  }
+
+  chrono::duration<double> fastestRun(const function<void (size_t)>& workload, size_t numThreads) {
+    chrono::duration<double> best = chrono::duration<double>::max();
+    for (size_t i = 0; i < kSpeedupRuns; i++) {
+      auto start = chrono::steady_clock::now();
+      workload(numThreads);
+      best = min<chrono::duration<double>>(best, chrono::steady_clock::now() - start);
+    }
+    return best;
+  }
+}
+
+void recordAvailableCPUs() {
+  wasPinned = (sched_getaffinity(0, sizeof(availableCPUs), &availableCPUs) == 0);
+}
+
+bool parallelRunFailed() {
+  return currentRunFailed != nullptr && currentRunFailed->load();
+}
+
+void runInParallel(size_t numThreads, const function<void (size_t)>& body) {
+  atomic<bool> failed(false);
+  atomic<bool> go(false);
+  exception_ptr firstFailure;
+  mutex failureLock;
+
+  auto runThread = [&](size_t index) {
+    currentRunFailed = &failed;
+    while (!go) {
+      this_thread::yield();
+    }
+
+    try {
+      body(index);
+    } catch (...) {
+      lock_guard<mutex> lock(failureLock);
+      if (!firstFailure) firstFailure = current_exception();
+      failed = true;
+    }
+    currentRunFailed = nullptr;
+  };
+
+  vector<thread> threads;
+  for (size_t i = 0; i < numThreads; i++) {
+    threads.emplace_back(runThread, i);
+  }
+  go = true;
+  for (auto& thread: threads) {
+    thread.join();
+  }
+
+  if (firstFailure) rethrow_exception(firstFailure);
+}
+
+void stressConcurrently(size_t numThreads, size_t operationsPerThread,
+                        const function<void (size_t, size_t)>& operation,
+                        const function<void ()>& invariant) {
+  runInParallel(numThreads, [&](size_t thread) {
+    for (size_t i = 0; i < operationsPerThread && !parallelRunFailed(); i++) {
+      operation(thread, i);
+    }
+  });
+
+  if (invariant) invariant();
+}
+
+void doExpectSpeedup(const function<void (size_t)>& workload, size_t maxThreads,
+                     double minSpeedup, const char* expression,
+                     size_t line, const char* filename) {
+  if (maxThreads < 2) doInternalError("Speedups need at least two threads to measure.", line, filename);
+
+  if (!wasPinned) {
+    logToDriver("  Warning: " + string(expression) + " is being timed in a test that isn't "
+                "timing-sensitive, so other tests running at the same time will skew its speedup.");
+  }
+
+  Unpinned unpinned;
+
+  /* A machine with fewer CPUs than threads can't deliver the full speedup, so scale the
+   * expectation down to what it could do at the same efficiency.
+   */
+  size_t numCPUs = numUsableCPUs();
+  double required = minSpeedup * min(1.0, double(numCPUs) / maxThreads);
+
+  ostringstream table;
+  table << "  Speedup of " << expression << " (" << numCPUs << " CPUs available):" << '\n'
+        << "    threads    seconds    speedup    efficiency" << '\n';
+
+  chrono::duration<double> baseline(0);
+  double speedup = 0;
+  for (size_t numThreads: threadCountsUpTo(maxThreads)) {
+    auto time = fastestRun(workload, numThreads);
+    if (numThreads == 1) baseline = time;
+
+    speedup = baseline / time;
+    table << fixed << setprecision(4)
+          << "    " << setw(7)  << numThreads
+          << "    " << setw(7)  << time.count()
+          << "    " << setw(6)  << setprecision(2) << speedup << "x"
+          << "    " << setw(9)  << setprecision(0) << 100 * speedup / numThreads << "%" << '\n';
+  }
+  if (baseline < kShortestReliableRun) {
+    table << "  Warning: one thread took under " << kShortestReliableRun.count()
+          << "ms, which is too fast to time reliably." << '\n';
+  }
+  string report = table.str();
+  report.pop_back();
+  logToDriver(report);
+
+  if (speedup < required) {
+    ostringstream message;
+    message << expression << " ran " << fixed << setprecision(2) << speedup << "x as fast with "
+            << maxThreads << " threads as with one; expected at least " << required << "x";
+    if (required != minSpeedup) message << " (scaled down from " << minSpeedup << "x for "
+                                        << numCPUs << " CPUs)";
+    message << ".";
+    doFailTest(message.str(), line, filename);
+  }
+}
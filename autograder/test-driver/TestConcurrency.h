@@ -0,0 +1,52 @@
+/* Tools for testing multithreaded code: running test code on several threads at once with
+ * failures carried back to the test, hammering a concurrent data structure from many threads,
+ * and measuring how well a parallel workload speeds up as it's given more threads.
+ */
+
+#ifndef TestConcurrency_Included
+#define TestConcurrency_Included
+
+#include <functional>
+#include <cstddef>
+
+/* Runs the given function on the given number of threads at once, passing each thread its
+ * index, and waits for them all to finish. The threads are released together so that they
+ * overlap as much as possible.
+ *
+ * Test failures are normally reported by throwing an exception, which would bring down the
+ * whole test if it happened on a thread of its own. Here, if the function fails on any thread
+ * (say, through EXPECT or FAIL_TEST), the failure is carried back and reported by the thread
+ * that called runInParallel once the others are done. Long-running functions can call
+ * parallelRunFailed() to stop early if some other thread already failed.
+ */
+void runInParallel(std::size_t numThreads, const std::function<void (std::size_t thread)>& body);
+
+/* Returns whether some thread in the current runInParallel has already failed. */
+bool parallelRunFailed();
+
+/* Stress-tests a concurrent data structure. Each of numThreads threads calls operation the
+ * given number of times, passing in its thread index and which operation it's on. Once every
+ * thread is done, invariant is called, from the test's own thread, to check that the data
+ * structure is still intact. For example:
+ *
+ *    ConcurrentQueue<int> queue;
+ *    std::atomic<int> removed(0);
+ *    stressConcurrently(8, 10000, [&](std::size_t thread, std::size_t i) {
+ *       if (i % 2 == 0) queue.push(thread);
+ *       else if (queue.tryPop()) removed++;
+ *    }, [&] {
+ *       EXPECT(queue.size() == 8 * 5000 - removed);
+ *    });
+ *
+ * Failures on any thread are reported as in runInParallel, and stop the other threads early.
+ */
+void stressConcurrently(std::size_t numThreads, std::size_t operationsPerThread,
+                        const std::function<void (std::size_t thread, std::size_t operation)>& operation,
+                        const std::function<void ()>& invariant = nullptr);
+
+/* Notes which CPUs this process may use before it's pinned to a single one. The test's
+ * child process calls this, so that speedup measurements can use every CPU again.
+ */
+void recordAvailableCPUs();
+
+#endif
@@ -0,0 +1,133 @@
+#include "TestCost.h"
+#include "TestChannel.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#include <cstring>
+using namespace std;
+
+namespace {
+  /* Instructions per second we assume when estimating from CPU time. Limits that pass on
+   * real hardware should usually pass with this estimate, but the estimate varies with
+   * the machine and its load.
+   */
+  const double kNominalInstructionsPerSecond = 3e9;
+
+  /* Opens a performance counter for the calling thread, returning -1 on failure. The
+   * counter belongs to the given group, or starts a new group if the group is -1.
+   */
+  int openCounter(uint64_t config, int group) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = config;
+    attr.disabled       = (group == -1);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+  }
+
+  /* Returns the CPU time used by this thread, in seconds. */
+  double threadCPUTime() {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+  }
+
+  /* A group of performance counters for the calling thread: instructions, plus cache and
+   * branch misses if we can get them. If the code being measured bails out partway through,
+   * say by failing the test, the counters are closed when the process exits.
+   */
+  class Counters {
+  public:
+    Counters() {
+      instructions = openCounter(PERF_COUNT_HW_INSTRUCTIONS, -1);
+      if (instructions == -1) return;
+      
+      /* The miss counters are a bonus. If we can't have both, we go without. */
+      cacheMisses  = openCounter(PERF_COUNT_HW_CACHE_MISSES, instructions);
+      branchMisses = cacheMisses == -1? -1 : openCounter(PERF_COUNT_HW_BRANCH_MISSES, instructions);
+      if (branchMisses == -1 && cacheMisses != -1) {
+        close(cacheMisses);
+        cacheMisses = -1;
+      }
+    }
+    
+    ~Counters() {
+      for (int fd: { instructions, cacheMisses, branchMisses }) {
+        if (fd != -1) close(fd);
+      }
+    }
+    
+    Counters(const Counters &) = delete;
+    void operator= (const Counters &) = delete;
+    
+    void start() {
+      if (instructions == -1) return;
+      ioctl(instructions, PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+      ioctl(instructions, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    
+    void stop() {
+      if (instructions == -1) return;
+      ioctl(instructions, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+    
+    /* Fills in the counts, returning whether the counters were working. */
+    bool read(Cost& cost) const {
+      if (instructions == -1) return false;
+      
+      /* With PERF_FORMAT_GROUP, we get the number of counters followed by their values. */
+      uint64_t values[4] = {};
+      if (::read(instructions, values, sizeof(values)) <= 0 || values[0] < 1) return false;
+      
+      cost.mode         = CostMode::HARDWARE_COUNTERS;
+      cost.instructions = values[1];
+      if (values[0] == 3) {
+        cost.cacheMisses   = values[2];
+        cost.branchMisses  = values[3];
+        cost.hasMissCounts = true;
+      }
+      return true;
+    }
+    
+  private:
+    int instructions = -1;
+    int cacheMisses  = -1;
+    int branchMisses = -1;
+  };
+}
+
+string to_string(CostMode mode) {
+  switch (mode) {
+    case CostMode::HARDWARE_COUNTERS: return "hardware counters";
+    case CostMode::CPU_TIME:          return "CPU time";
+    default:                          return "unknown";
+  }
+}
+
+Cost measureCost(const function<void ()>& code) {
+  Counters counters;
+  
+  /* We time the code too, in case the counters turn out not to work. */
+  double start = threadCPUTime();
+  counters.start();
+  code();
+  counters.stop();
+  double elapsed = threadCPUTime() - start;
+  
+  Cost cost;
+  if (!counters.read(cost)) {
+    cost.mode         = CostMode::CPU_TIME;
+    cost.instructions = elapsed * kNominalInstructionsPerSecond;
+  }
+  
+  logToDriver("  Measured " + std::to_string(cost.instructions) + " instructions using " +
+              to_string(cost.mode) + ".");
+  return cost;
+}
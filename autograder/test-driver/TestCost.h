@@ -0,0 +1,38 @@
+/* Functions for measuring how much work a piece of code does. Wherever possible this uses the
+ * CPU's performance counters, which give nearly the same answer on every run and every
+ * machine. Where those aren't available (many containers block them), it falls back on
+ * measuring CPU time and converting that into an estimated instruction count.
+ */
+
+#ifndef TestCost_Included
+#define TestCost_Included
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/* How a cost was measured. */
+enum class CostMode {
+  HARDWARE_COUNTERS, // Read from the CPU's performance counters.
+  CPU_TIME           // Estimated from CPU time; much noisier.
+};
+
+std::string to_string(CostMode mode);
+
+/* How much work some code did. The miss counts are only available with hardware counters,
+ * and even then not on every CPU; hasMissCounts says whether they were measured.
+ */
+struct Cost {
+  CostMode      mode;
+  std::uint64_t instructions = 0;
+  std::uint64_t cacheMisses  = 0;
+  std::uint64_t branchMisses = 0;
+  bool          hasMissCounts = false;
+};
+
+/* Runs the given function, returning how much work it did. Only work done on the calling
+ * thread is counted.
+ */
+Cost measureCost(const std::function<void ()>& code);
+
+#endif
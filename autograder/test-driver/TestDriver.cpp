@@ -1,5 +1,14 @@
 #include "Test.h"
 #include "TestCommon.h"
+#include "TestOptions.h"
+#include "TestScheduler.h"
+#include "TestTimings.h"
+#include "TestCalibration.h"
+#include "TestAllocations.h"
+#include "TestStages.h"
+#include "TestSanitizer.h"
+#include "TestOutcomes.h"
+#include "TestMetrics.h"
 #include "JSON.h"
 #include <iostream>
 #include <string>
@@ -7,15 +16,153 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <chrono>
+#include <algorithm>
 using namespace std;
 
 namespace {
-  /* Runs all the root tests, returning the results. */
-  vector<shared_ptr<TestResult>> runAllTests(const set<string>& missingFiles) {
+  /* Returns the root tests in this run's shard, which is all of them unless --shard was
+   * given. Biggest first, each group goes to whichever shard has the fewest tests so far,
+   * so every run over the same tests agrees on which shard runs what.
+   */
+  vector<shared_ptr<Test>> shardTests() {
+    auto tests = allTests();
+    if (testOptions().numShards == 1) return tests;
+    
+    auto bySize = tests;
+    stable_sort(bySize.begin(), bySize.end(), [](auto lhs, auto rhs) {
+      return lhs->numTests() > rhs->numTests();
+    });
+    
+    vector<size_t> shardSizes(testOptions().numShards);
+    set<shared_ptr<Test>> ours;
+    for (auto test: bySize) {
+      auto smallest = min_element(shardSizes.begin(), shardSizes.end());
+      *smallest += test->numTests();
+      if (size_t(smallest - shardSizes.begin()) == testOptions().shard) ours.insert(test);
+    }
+    
+    /* Keep the usual order, so results are reported the same way as ever. */
+    vector<shared_ptr<Test>> result;
+    for (auto test: tests) {
+      if (ours.count(test)) result.push_back(test);
+    }
+    return result;
+  }
+  
+  /* Returns the root tests to run, which is all of them in the shard unless --from-file
+   * was given.
+   */
+  vector<shared_ptr<Test>> selectedTests() {
+    const auto& files = testOptions().sourceFiles;
+    if (files.empty()) return shardTests();
+    
+    vector<shared_ptr<Test>> result;
+    for (auto test: shardTests()) {
+      if (test->definedIn(files)) result.push_back(test);
+    }
+    return result;
+  }
+  
+  /* Gathers all the test cases that need to be run. */
+  vector<ScheduledTest> gatherAllTests(const set<string>& missingFiles) {
+    vector<ScheduledTest> work;
+    for (auto test: selectedTests()) {
+      test->gather(missingFiles, "", work);
+    }
+    return work;
+  }
+  
+  /* Loads the outcomes saved by an earlier run, returning which root tests still need to
+   * run: those defined in a --from-file file, and those that don't have a saved outcome for
+   * every one of their test cases. The rest are listed in reused.
+   */
+  vector<shared_ptr<Test>> reuseOutcomes(const set<string>& missingFiles, const string& filename,
+                                         vector<ScheduledTest>& reused, Outcomes& outcomes) {
+    const auto& files = testOptions().sourceFiles;
+    
+    /* List every root's test cases first, so the file only has to be read once. */
+    auto roots = shardTests();
+    vector<vector<ScheduledTest>> casesOf(roots.size());
+    vector<ScheduledTest> allCases;
+    for (size_t i = 0; i < roots.size(); i++) {
+      roots[i]->list(missingFiles, "", casesOf[i]);
+      allCases.insert(allCases.end(), casesOf[i].begin(), casesOf[i].end());
+    }
+    Outcomes saved = loadOutcomes(filename, allCases);
+    
+    vector<shared_ptr<Test>> result;
+    for (size_t i = 0; i < roots.size(); i++) {
+      auto test = roots[i];
+      const auto& cases = casesOf[i];
+      bool allSaved = all_of(cases.begin(), cases.end(), [&](const ScheduledTest& oneCase) {
+        return saved.count(oneCase.test.get());
+      });
+      
+      if (test->definedIn(files) || !allSaved) {
+        result.push_back(test);
+      } else {
+        cout << "Reusing results from the last run for " << test->name() << "." << endl;
+        reused.insert(reused.end(), cases.begin(), cases.end());
+        for (const auto& oneCase: cases) {
+          outcomes[oneCase.test.get()] = saved[oneCase.test.get()];
+        }
+      }
+    }
+    return result;
+  }
+  
+  /* Runs all the root tests, returning the results. If a timing database is given, it's
+   * used to decide what order to run the tests in and is updated afterwards. If there's a
+   * file of earlier outcomes to reuse, only tests selected with --from-file, or that have no
+   * saved outcome, are run. If there's a file to save outcomes to, they all go there.
+   */
+  vector<shared_ptr<TestResult>> runAllTests(const set<string>& missingFiles,
+                                             const char* timingFile,
+                                             const string& missingList = "",
+                                             const char* sanitizedRunner = nullptr,
+                                             const char* reuseFile = nullptr,
+                                             const char* saveFile = nullptr) {
+    TimingDatabase timings;
+    if (timingFile) timings.load(timingFile);
+    
+    vector<ScheduledTest> work, reused;
+    Outcomes outcomes;
+    {
+      TimedStage stage("gather");
+      auto toRun = reuseFile? reuseOutcomes(missingFiles, reuseFile, reused, outcomes) : selectedTests();
+      for (auto test: toRun) {
+        test->gather(missingFiles, "", work);
+      }
+    }
+    stageTimings().recordTestCount(work.size());
+    
+    {
+      TimedStage stage("execute");
+      auto ran = runScheduled(work, timings);
+      outcomes.insert(ran.begin(), ran.end());
+    }
+    
+    if (sanitizedRunner) {
+      TimedStage stage("sanitize");
+      sanitizeFailures(work, outcomes, sanitizedRunner, missingList);
+    }
+    
+    /* Results are reported in the usual order, regardless of what order the tests ran in. */
     vector<shared_ptr<TestResult>> results;
-    for (auto test: allTests()) {
-      results.push_back(test->run(missingFiles));
+    {
+      TimedStage stage("report");
+      for (auto test: reuseFile? shardTests() : selectedTests()) {
+        results.push_back(test->report(missingFiles, outcomes));
+        test->cleanUp();
+      }
+    }
+    
+    if (saveFile) {
+      work.insert(work.end(), reused.begin(), reused.end());
+      saveOutcomes(saveFile, work, outcomes);
     }
+    if (timingFile) timings.save(timingFile);
     return results;
   }
   
@@ -134,24 +281,118 @@ namespace {
     cout << total;
   }
   
+  /* Program mode: Describe every test without running any of them. This is all a runner
+   * linked without the student's code can safely do.
+   */
+  void writeTestManifest(const string& filename) {
+    Points total = 0;
+    vector<JSON> tests;
+    for (auto test: allTests()) {
+      total += test->pointsPossible();
+      tests.push_back(test->manifest());
+    }
+    
+    ofstream output(filename);
+    if (!output) emergencyAbort("Could not open file " + filename + " for writing.");
+    output << JSON::object({
+      { "points", total },
+      { "tests",  tests }
+    });
+  }
+  
+  /* Reads which shard to run, given as K/N: the Kth of N shards, counting from one. */
+  void parseShard(const string& shard) {
+    size_t slash = shard.find('/');
+    if (slash == string::npos) throw invalid_argument("--shard should look like K/N.");
+    
+    size_t index     = stoul(shard.substr(0, slash));
+    size_t numShards = stoul(shard.substr(slash + 1));
+    if (index == 0 || index > numShards) throw invalid_argument("--shard K/N needs K between 1 and N.");
+    
+    testOptions().shard     = index - 1;
+    testOptions().numShards = numShards;
+  }
+  
+  /* Makes sure no one mistakes a --no-fork run for a real one. */
+  void warnAboutNoFork() {
+    cout << "************************************************************************" << endl;
+    cout << "* WARNING: Running tests with --no-fork. Tests run inside the driver,  *" << endl;
+    cout << "* so a misbehaving test can hang the run or corrupt later tests, and   *" << endl;
+    cout << "* timeouts aren't enforced. This is for developing tests only. Never   *" << endl;
+    cout << "* use it to grade submissions.                                         *" << endl;
+    cout << "************************************************************************" << endl;
+    
+    /* Allocation checks still work, though with several jobs, tests running at the same
+     * time show up in each other's counts.
+     */
+    enableAllocationTracking();
+  }
+  
+  /* Program mode: Work out timeouts from a reference solution. */
+  void calibrateTests(const string& calibrationFile, const char* missingList,
+                      const char* timingFile) {
+    TimingDatabase timings;
+    if (timingFile) timings.load(timingFile);
+    
+    auto missing = missingList? missingFiles(missingList) : set<string>();
+    calibrate(gatherAllTests(missing), timings, calibrationFile);
+    for (auto test: selectedTests()) {
+      test->cleanUp();
+    }
+    
+    if (timingFile) timings.save(timingFile);
+    cout << "Generated calibration file " << calibrationFile << endl;
+  }
+  
+  /* Program mode: Run tests that misbehaved again, in a build with the sanitizers. */
+  void checkUnderSanitizers(const string& requestFile, const string& reportFile,
+                            const string& missingList) {
+    writeSanitizerReports(gatherAllTests(missingFiles(missingList)), requestFile, reportFile);
+    for (auto test: selectedTests()) {
+      test->cleanUp();
+    }
+  }
+  
   /* Program mode: Run all tests! */
-  void runTests(const string& outfile, const string& missingList, JSON config) {
+  void runTests(const string& outfile, const string& missingList, JSON config,
+                const char* timingFile, const char* stageFile, const char* sanitizedRunner,
+                const char* reuseFile, const char* saveFile, const char* metricsFile) {
     ofstream output(outfile);
     if (!output) emergencyAbort("Could not open file " + outfile + " for writing.");
     
-    reportResults(missingList, runAllTests(missingFiles(missingList)), output, config);
+    auto results = runAllTests(missingFiles(missingList), timingFile, missingList, sanitizedRunner,
+                               reuseFile, saveFile);
+    {
+      TimedStage stage("render");
+      reportResults(missingList, results, output, config);
+      output.close();
+    }
     
     /* For debugging purposes, dump the generated JSON. */
-    output.close();
     cout << "Generated JSON file " << outfile << " with these contents: " << endl;
     cout << contentsOf(outfile) << endl;
+    
+    if (stageFile)   stageTimings().save(stageFile);
+    if (metricsFile) runMetrics().save(metricsFile);
   }
 }
 
 int main(int argc, const char* argv[]) try {
+  recordRegistrationTime();
+  
   const char* outputFile  = nullptr;
   const char* missingList = nullptr;
   const char* configFile  = nullptr;
+  const char* timingFile  = nullptr;
+  const char* calibrationFile = nullptr;
+  const char* calibrateTo     = nullptr;
+  const char* stageFile       = nullptr;
+  const char* sanitizedRunner = nullptr;
+  const char* sanitizerCheck  = nullptr;
+  const char* reuseFile       = nullptr;
+  const char* saveFile        = nullptr;
+  const char* metricsFile     = nullptr;
+  const char* manifestFile    = nullptr;
   bool countPoints = false;
   
   for (int i = 1; i < argc; i++) {
@@ -172,6 +413,116 @@ int main(int argc, const char* argv[]) try {
       if (i + 1 == argc)          throw invalid_argument("-j flag with no argument.");
       i++;
       configFile = argv[i];
+    } else if (string(argv[i]) == "--output-limit") {
+      if (i + 1 == argc)          throw invalid_argument("--output-limit flag with no argument.");
+      i++;
+      testOptions().outputLimit = stoul(argv[i]);
+    } else if (string(argv[i]) == "--show-output") {
+      testOptions().showOutput = true;
+    } else if (string(argv[i]) == "-p" || string(argv[i]) == "--jobs") {
+      if (i + 1 == argc)          throw invalid_argument(string(argv[i]) + " flag with no argument.");
+      i++;
+      testOptions().numJobs = stoul(argv[i]);
+      if (testOptions().numJobs == 0) throw invalid_argument("Need at least one job.");
+    } else if (string(argv[i]) == "-t") {
+      if (timingFile != nullptr)  throw invalid_argument("Multiple -t flags.");
+      if (i + 1 == argc)          throw invalid_argument("-t flag with no argument.");
+      i++;
+      timingFile = argv[i];
+    } else if (string(argv[i]) == "--stage-timings") {
+      if (stageFile != nullptr)   throw invalid_argument("Multiple --stage-timings flags.");
+      if (i + 1 == argc)          throw invalid_argument("--stage-timings flag with no argument.");
+      i++;
+      stageFile = argv[i];
+    } else if (string(argv[i]) == "--sanitized-runner") {
+      if (sanitizedRunner != nullptr) throw invalid_argument("Multiple --sanitized-runner flags.");
+      if (i + 1 == argc)          throw invalid_argument("--sanitized-runner flag with no argument.");
+      i++;
+      sanitizedRunner = argv[i];
+    } else if (string(argv[i]) == "--sanitizer-check") {
+      if (sanitizerCheck != nullptr) throw invalid_argument("Multiple --sanitizer-check flags.");
+      if (i + 1 == argc)          throw invalid_argument("--sanitizer-check flag with no argument.");
+      i++;
+      sanitizerCheck = argv[i];
+    } else if (string(argv[i]) == "--metrics") {
+      if (metricsFile != nullptr) throw invalid_argument("Multiple --metrics flags.");
+      if (i + 1 == argc)          throw invalid_argument("--metrics flag with no argument.");
+      i++;
+      metricsFile = argv[i];
+    } else if (string(argv[i]) == "--reuse-outcomes") {
+      if (reuseFile != nullptr)   throw invalid_argument("Multiple --reuse-outcomes flags.");
+      if (i + 1 == argc)          throw invalid_argument("--reuse-outcomes flag with no argument.");
+      i++;
+      reuseFile = argv[i];
+    } else if (string(argv[i]) == "--save-outcomes") {
+      if (saveFile != nullptr)    throw invalid_argument("Multiple --save-outcomes flags.");
+      if (i + 1 == argc)          throw invalid_argument("--save-outcomes flag with no argument.");
+      i++;
+      saveFile = argv[i];
+    } else if (string(argv[i]) == "--test-manifest") {
+      if (manifestFile != nullptr) throw invalid_argument("Multiple --test-manifest flags.");
+      if (i + 1 == argc)          throw invalid_argument("--test-manifest flag with no argument.");
+      i++;
+      manifestFile = argv[i];
+    } else if (string(argv[i]) == "--shard") {
+      if (i + 1 == argc)          throw invalid_argument("--shard flag with no argument.");
+      i++;
+      parseShard(argv[i]);
+    } else if (string(argv[i]) == "--report-schedule") {
+      testOptions().reportSchedule = true;
+    } else if (string(argv[i]) == "--from-file") {
+      if (i + 1 == argc)          throw invalid_argument("--from-file flag with no argument.");
+      i++;
+      testOptions().sourceFiles.insert(sourceFileName(argv[i]));
+    } else if (string(argv[i]) == "--no-fork") {
+      testOptions().noFork = true;
+    } else if (string(argv[i]) == "--property-seed") {
+      if (i + 1 == argc)          throw invalid_argument("--property-seed flag with no argument.");
+      i++;
+      testOptions().propertySeed = stoull(argv[i]);
+    } else if (string(argv[i]) == "--property-cases") {
+      if (i + 1 == argc)          throw invalid_argument("--property-cases flag with no argument.");
+      i++;
+      testOptions().propertyCases = stoul(argv[i]);
+    } else if (string(argv[i]) == "--property-budget") {
+      if (i + 1 == argc)          throw invalid_argument("--property-budget flag with no argument.");
+      i++;
+      testOptions().propertyBudget = stod(argv[i]);
+    } else if (string(argv[i]) == "--test-data") {
+      if (i + 1 == argc)          throw invalid_argument("--test-data flag with no argument.");
+      i++;
+      testOptions().testData = argv[i];
+    } else if (string(argv[i]) == "--timing-warmup") {
+      if (i + 1 == argc)          throw invalid_argument("--timing-warmup flag with no argument.");
+      i++;
+      testOptions().timingWarmup = chrono::milliseconds(stoul(argv[i]));
+    } else if (string(argv[i]) == "--timeout") {
+      if (i + 1 == argc)          throw invalid_argument("--timeout flag with no argument.");
+      i++;
+      testOptions().defaultTimeout = stod(argv[i]);
+    } else if (string(argv[i]) == "-c") {
+      if (calibrationFile != nullptr) throw invalid_argument("Multiple -c flags.");
+      if (i + 1 == argc)          throw invalid_argument("-c flag with no argument.");
+      i++;
+      calibrationFile = argv[i];
+    } else if (string(argv[i]) == "--calibrate") {
+      if (calibrateTo != nullptr) throw invalid_argument("Multiple --calibrate flags.");
+      if (i + 1 == argc)          throw invalid_argument("--calibrate flag with no argument.");
+      i++;
+      calibrateTo = argv[i];
+    } else if (string(argv[i]) == "--calibration-runs") {
+      if (i + 1 == argc)          throw invalid_argument("--calibration-runs flag with no argument.");
+      i++;
+      testOptions().calibrationRuns = stoul(argv[i]);
+      if (testOptions().calibrationRuns == 0) throw invalid_argument("Need at least one calibration run.");
+    } else if (string(argv[i]) == "--timeout-multiplier") {
+      if (i + 1 == argc)          throw invalid_argument("--timeout-multiplier flag with no argument.");
+      i++;
+      testOptions().timeoutMultiplier = stod(argv[i]);
+    } else if (string(argv[i]) == "--timeout-floor") {
+      if (i + 1 == argc)          throw invalid_argument("--timeout-floor flag with no argument.");
+      i++;
+      testOptions().timeoutFloor = stod(argv[i]);
     } else {
       throw invalid_argument("Unknown command-line option: " + string(argv[i]));
     }
@@ -181,6 +532,17 @@ int main(int argc, const char* argv[]) try {
   if (countPoints) {
     if (outputFile || missingList) throw invalid_argument("--count-points cannot be used with other flags.");
     countPossiblePoints();
+  } else if (manifestFile) {
+    if (outputFile || missingList) throw invalid_argument("--test-manifest cannot be used with -o or -m.");
+    writeTestManifest(manifestFile);
+  } else if (sanitizerCheck) {
+    if (!outputFile || !missingList) throw invalid_argument("--sanitizer-check needs -o and -m.");
+    if (calibrationFile) loadCalibration(calibrationFile);
+    checkUnderSanitizers(sanitizerCheck, outputFile, missingList);
+  } else if (calibrateTo) {
+    if (outputFile || calibrationFile) throw invalid_argument("--calibrate cannot be used with -o or -c.");
+    if (testOptions().noFork)          throw invalid_argument("--calibrate cannot be used with --no-fork.");
+    calibrateTests(calibrateTo, missingList, timingFile);
   } else {
     if (!outputFile)  throw invalid_argument("No output file specified.");
     if (!missingList) throw invalid_argument("No missing file list specified.");
@@ -194,7 +556,11 @@ int main(int argc, const char* argv[]) try {
         config = JSON::parse(input);
     }
     
-    runTests(outputFile, missingList, config);
+    if (calibrationFile) loadCalibration(calibrationFile);
+    if (testOptions().noFork) warnAboutNoFork();
+    
+    runTests(outputFile, missingList, config, timingFile, stageFile, sanitizedRunner,
+             reuseFile, saveFile, metricsFile);
   }
 } catch (const exception& e) {
   emergencyAbort(string("Unhandled exception: ") + e.what());
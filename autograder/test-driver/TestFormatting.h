@@ -0,0 +1,121 @@
+/* Turning values into text for test failure messages. formatForTest() works out a sensible
+ * way to print most types: anything with an operator<<, containers, pairs, and tuples. To
+ * control how some other type is printed, specialize TestFormatter for it:
+ *
+ *    template <> struct TestFormatter<GridLocation> {
+ *       static std::string format(const GridLocation& loc) {
+ *          return "(" + std::to_string(loc.row) + ", " + std::to_string(loc.col) + ")";
+ *       }
+ *    };
+ */
+
+#ifndef TestFormatting_Included
+#define TestFormatting_Included
+
+#include <string>
+#include <sstream>
+#include <charconv>
+#include <tuple>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+
+template <typename T> struct TestFormatter;
+
+/* Returns a human-readable version of the given value. */
+template <typename T> std::string formatForTest(const T& value) {
+  return TestFormatter<T>::format(value);
+}
+
+/* Type traits used to pick a way to print things. */
+namespace TestFormattingDetail {
+  template <typename T, typename = void> struct IsStreamable: std::false_type {};
+  template <typename T> struct IsStreamable<T,
+    std::void_t<decltype(std::declval<std::ostream&>() << std::declval<const T&>())>>: std::true_type {};
+
+  template <typename T, typename = void> struct IsRange: std::false_type {};
+  template <typename T> struct IsRange<T,
+    std::void_t<decltype(std::begin(std::declval<const T&>())),
+                decltype(std::end(std::declval<const T&>()))>>: std::true_type {};
+
+  template <typename T> struct IsTuple: std::false_type {};
+  template <typename... Ts> struct IsTuple<std::tuple<Ts...>>: std::true_type {};
+  template <typename A, typename B> struct IsTuple<std::pair<A, B>>: std::true_type {};
+
+  /* Integer types the streams would print as characters even though they're usually used
+   * as small numbers, such as int8_t and uint8_t.
+   */
+  template <typename T> constexpr bool kIsByteInteger =
+    std::is_integral_v<T> && sizeof(T) == 1 && !std::is_same_v<T, char> && !std::is_same_v<T, bool>;
+
+  /* Writes a character inside quotes, escaping the quote, backslashes, and anything that
+   * isn't printable, so that every character shows up and none of them can garble the
+   * message around it.
+   */
+  inline void writeEscaped(std::ostream& out, char ch, char quote) {
+    switch (ch) {
+      case '\n': out << "\\n";  return;
+      case '\t': out << "\\t";  return;
+      case '\r': out << "\\r";  return;
+      case '\0': out << "\\0";  return;
+      case '\\': out << "\\\\"; return;
+    }
+    if (ch == quote) {
+      out << '\\' << ch;
+    } else if (ch >= 0x20 && ch < 0x7F) {
+      out << ch;
+    } else {
+      const char* kDigits = "0123456789abcdef";
+      auto byte = static_cast<unsigned char>(ch);
+      out << "\\x" << kDigits[byte >> 4] << kDigits[byte & 0xF];
+    }
+  }
+}
+
+template <typename T> struct TestFormatter {
+  static std::string format(const T& value) {
+    using namespace TestFormattingDetail;
+
+    std::ostringstream result;
+    if constexpr (std::is_same_v<T, std::string>) {
+      result << '"';
+      for (char ch: value) writeEscaped(result, ch, '"');
+      result << '"';
+    } else if constexpr (std::is_same_v<T, char>) {
+      result << "'";
+      writeEscaped(result, value, '\'');
+      result << "'";
+    } else if constexpr (kIsByteInteger<T>) {
+      result << +value;
+    } else if constexpr (std::is_same_v<T, bool>) {
+      result << std::boolalpha << value;
+    } else if constexpr (std::is_floating_point_v<T>) {
+      /* The fewest digits that pin down the value, so values that differ print differently. */
+      char buffer[64];
+      auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+      result.write(buffer, end - buffer);
+    } else if constexpr (IsTuple<T>::value) {
+      result << "(";
+      std::apply([&](const auto&... parts) {
+        const char* separator = "";
+        ((result << separator << formatForTest(parts), separator = ", "), ...);
+      }, value);
+      result << ")";
+    } else if constexpr (IsStreamable<T>::value) {
+      result << value;
+    } else if constexpr (IsRange<T>::value) {
+      result << "{";
+      const char* separator = "";
+      for (const auto& elem: value) {
+        result << separator << formatForTest(elem);
+        separator = ", ";
+      }
+      result << "}";
+    } else {
+      result << "<value that can't be printed>";
+    }
+    return result.str();
+  }
+};
+
+#endif
@@ -0,0 +1,416 @@
+#include "TestGoldenFile.h"
+#include "TestCase.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <deque>
+#include <vector>
+using namespace std;
+
+namespace {
+  /* How many matching lines to show before the first one that differs. */
+  const size_t kContextLines = 2;
+
+  /* Longest line to show in a failure message. Past this, lines are cut off. */
+  const size_t kMaxShownLength = 200;
+
+  /* How many bytes to read from the test's output at once. */
+  const size_t kBufferSize = 64 * 1024;
+
+  /* Read-only view of a whole file, mapped into memory. */
+  class MappedFile {
+  public:
+    explicit MappedFile(const string& filename) {
+      int fd = open(filename.c_str(), O_RDONLY);
+      if (fd == -1) return;
+
+      struct stat info;
+      if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        length = info.st_size;
+        isValid = true;
+
+        /* mmap refuses to map nothing, so empty files are left unmapped. */
+        if (length != 0) {
+          void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (mapped == MAP_FAILED) {
+            isValid = false;
+          } else {
+            contents = static_cast<const char*>(mapped);
+            madvise(mapped, length, MADV_SEQUENTIAL);
+          }
+        }
+      }
+      close(fd);
+    }
+
+    ~MappedFile() {
+      if (contents != nullptr) munmap(const_cast<char*>(contents), length);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    void operator= (const MappedFile&) = delete;
+
+    bool        valid() const { return isValid; }
+    const char* data()  const { return contents != nullptr? contents : ""; }
+    size_t      size()  const { return length; }
+
+  private:
+    const char* contents = nullptr;
+    size_t      length   = 0;
+    bool        isValid  = false;
+  };
+
+  /* Where output first stopped matching. */
+  struct Difference {
+    size_t         lineNumber = 0;
+    deque<string>  context;           // Matching lines just before this one.
+    string         expected, actual;
+    bool           expectedEnded = false, actualEnded = false;
+  };
+
+  /* Makes a line of output readable in a failure message. Tabs and carriage returns get
+   * spelled out, since a stray \r from a Windows text file is a classic way to fail.
+   */
+  string shown(const string& line) {
+    string result = "\"";
+    for (size_t i = 0; i < line.size() && i < kMaxShownLength; i++) {
+      if      (line[i] == '\t') result += "\\t";
+      else if (line[i] == '\r') result += "\\r";
+      else if (line[i] == '"')  result += "\\\"";
+      else if (line[i] == '\\') result += "\\\\";
+      else                      result += line[i];
+    }
+    result += "\"";
+    if (line.size() > kMaxShownLength) result += "...";
+    return result;
+  }
+
+  bool isBlank(const char* begin, const char* end) {
+    return all_of(begin, end, [](char ch) { return isspace(static_cast<unsigned char>(ch)); });
+  }
+
+  /* Splits a line into its whitespace-separated words. */
+  vector<string> wordsIn(const char* begin, const char* end) {
+    vector<string> result;
+    while (true) {
+      begin = find_if(begin, end, [](char ch) { return !isspace(static_cast<unsigned char>(ch)); });
+      if (begin == end) return result;
+
+      auto wordEnd = find_if(begin, end, [](char ch) { return isspace(static_cast<unsigned char>(ch)); });
+      result.emplace_back(begin, wordEnd);
+      begin = wordEnd;
+    }
+  }
+
+  /* Reads a word as a number, returning whether the whole word is one. */
+  bool asNumber(const string& word, double& result) {
+    char* end;
+    errno = 0;
+    result = strtod(word.c_str(), &end);
+    return end != word.c_str() && *end == '\0' && errno == 0;
+  }
+
+  /* Compares output, fed in however it happens to arrive, against the expected output.
+   *
+   * Exact comparisons run straight over the bytes with memcmp, which is vectorized, and
+   * only work out line numbers and context once something differs. Looser comparisons have
+   * to go line by line.
+   */
+  class OutputMatcher {
+  public:
+    OutputMatcher(const char* expected, size_t length, const OutputComparison& comparison)
+      : expected(expected), expectedEnd(expected + length), cursor(expected),
+        comparison(comparison), lineWise(comparison.ignoreWhitespace || comparison.compareNumbers) {
+
+    }
+
+    void feed(const char* data, size_t length) {
+      if (lineWise) feedLines(data, length);
+      else          feedBytes(data, length);
+    }
+
+    /* Called once all output has been fed in. Returns whether it all matched. */
+    bool finish() {
+      if (lineWise) {
+        if (!failed && !partial.empty()) matchLine(partial);
+        if (!failed) {
+          const char* begin;
+          const char* end;
+          if (nextExpectedLine(begin, end)) {
+            fail(string(begin, end), "", false, true);
+          }
+        }
+      } else if (!failed && cursor != expectedEnd) {
+        failAt(cursor);
+        difference.actualEnded = difference.actual.empty();
+      }
+      return !failed;
+    }
+
+    /* Describes what went wrong. Only meaningful if finish() returned false. */
+    const Difference& firstDifference() const {
+      return difference;
+    }
+
+  private:
+    const char* const expected;
+    const char* const expectedEnd;
+    const char* cursor;                 // Next byte of expected output to match.
+    const OutputComparison comparison;
+    const bool lineWise;
+
+    bool failed = false;
+    Difference difference;
+
+    /* Exact mode: how much of the line that differed has been collected so far. */
+    bool collectingTail = false;
+
+    /* Line mode: the line being assembled, and how many lines have been seen. */
+    string partial;
+    size_t lineNumber = 0;
+
+    void feedBytes(const char* data, size_t length) {
+      if (failed) {
+        collectTail(data, length);
+        return;
+      }
+
+      size_t comparable = min<size_t>(length, expectedEnd - cursor);
+      if (memcmp(data, cursor, comparable) == 0) {
+        cursor += comparable;
+        if (comparable == length) return;
+
+        /* Printed more than expected. */
+        failAt(cursor);
+        collectTail(data + comparable, length - comparable);
+        return;
+      }
+
+      size_t same = mismatch(data, data + comparable, cursor).first - data;
+      failAt(cursor + same);
+      collectTail(data + same, length - same);
+    }
+
+    /* Records a difference at the given point in the expected output. Everything printed
+     * on that line up to that point matched, so it can be read from the expected output.
+     */
+    void failAt(const char* position) {
+      failed = true;
+      collectingTail = true;
+
+      const char* lineStart = position;
+      while (lineStart != expected && lineStart[-1] != '\n') lineStart--;
+
+      difference.lineNumber = 1 + count(expected, lineStart, '\n');
+      difference.actual     = string(lineStart, position);
+
+      auto lineEnd = static_cast<const char*>(memchr(position, '\n', expectedEnd - position));
+      if (lineEnd == nullptr) lineEnd = expectedEnd;
+      difference.expected      = string(lineStart, lineEnd);
+      difference.expectedEnded = (lineStart == expectedEnd);
+
+      for (const char* before = lineStart; before != expected &&
+           difference.context.size() < kContextLines; ) {
+        const char* contextEnd = before - 1;
+        const char* contextStart = contextEnd;
+        while (contextStart != expected && contextStart[-1] != '\n') contextStart--;
+        difference.context.emplace_front(contextStart, contextEnd);
+        before = contextStart;
+      }
+    }
+
+    /* Adds what was printed after the difference, through the end of that line. */
+    void collectTail(const char* data, size_t length) {
+      if (!collectingTail) return;
+
+      auto newline = static_cast<const char*>(memchr(data, '\n', length));
+      size_t wanted = (newline == nullptr? length : newline - data);
+      difference.actual.append(data, min(wanted, kMaxShownLength + 1));
+      if (newline != nullptr || difference.actual.size() > kMaxShownLength) {
+        collectingTail = false;
+      }
+    }
+
+    void feedLines(const char* data, size_t length) {
+      const char* end = data + length;
+      while (!failed && data != end) {
+        auto newline = static_cast<const char*>(memchr(data, '\n', end - data));
+        if (newline == nullptr) {
+          partial.append(data, end);
+          return;
+        }
+
+        partial.append(data, newline);
+        matchLine(partial);
+        partial.clear();
+        data = newline + 1;
+      }
+    }
+
+    /* Finds the next nonblank line of expected output, returning whether there is one. */
+    bool nextExpectedLine(const char*& begin, const char*& end) {
+      while (cursor != expectedEnd) {
+        begin = cursor;
+        end   = static_cast<const char*>(memchr(cursor, '\n', expectedEnd - cursor));
+        if (end == nullptr) end = expectedEnd;
+        cursor = (end == expectedEnd? end : end + 1);
+
+        if (!isBlank(begin, end)) return true;
+      }
+      return false;
+    }
+
+    void matchLine(const string& line) {
+      lineNumber++;
+      if (isBlank(line.data(), line.data() + line.size())) return;
+
+      const char* begin;
+      const char* end;
+      if (!nextExpectedLine(begin, end)) {
+        fail("", line, true, false);
+      } else if (!sameWords(wordsIn(begin, end), wordsIn(line.data(), line.data() + line.size()))) {
+        fail(string(begin, end), line, false, false);
+      } else {
+        difference.context.push_back(line);
+        if (difference.context.size() > kContextLines) difference.context.pop_front();
+      }
+    }
+
+    bool sameWords(const vector<string>& expectedWords, const vector<string>& actualWords) const {
+      if (expectedWords.size() != actualWords.size()) return false;
+
+      for (size_t i = 0; i < expectedWords.size(); i++) {
+        if (expectedWords[i] == actualWords[i]) continue;
+
+        double expectedValue, actualValue;
+        if (!comparison.compareNumbers ||
+            !asNumber(expectedWords[i], expectedValue) || !asNumber(actualWords[i], actualValue) ||
+            !(fabs(expectedValue - actualValue) <= comparison.tolerance * max(1.0, fabs(expectedValue)))) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    void fail(const string& expectedLine, const string& actualLine,
+              bool expectedEnded, bool actualEnded) {
+      failed = true;
+      difference.lineNumber    = lineNumber + (actualEnded? 1 : 0);
+      difference.expected      = expectedLine;
+      difference.actual        = actualLine;
+      difference.expectedEnded = expectedEnded;
+      difference.actualEnded   = actualEnded;
+    }
+  };
+
+  /* Sends everything written to stdout into a pipe for as long as it's alive, with a
+   * separate thread feeding what comes out of the pipe to a matcher. Reading while the code
+   * runs means the pipe never fills up, and the output never has to be stored.
+   */
+  class StdoutRedirect {
+  public:
+    StdoutRedirect(OutputMatcher& matcher, size_t line, const char* filename) {
+      cout.flush();
+      fflush(stdout);
+
+      int fds[2];
+      if (pipe(fds) == -1) doInternalError("Couldn't create a pipe to capture output.", line, filename);
+
+      savedStdout = dup(STDOUT_FILENO);
+      if (savedStdout == -1 || dup2(fds[1], STDOUT_FILENO) == -1) {
+        close(fds[0]);
+        close(fds[1]);
+        if (savedStdout != -1) close(savedStdout);
+        doInternalError("Couldn't redirect stdout to capture output.", line, filename);
+      }
+      close(fds[1]);
+      readEnd = fds[0];
+
+      reader = thread([this, &matcher] {
+        vector<char> buffer(kBufferSize);
+        while (true) {
+          auto bytes = read(readEnd, buffer.data(), buffer.size());
+          if (bytes == -1 && errno == EINTR) continue;
+          if (bytes <= 0) return;
+
+          matcher.feed(buffer.data(), bytes);
+        }
+      });
+    }
+
+    /* Puts stdout back. That closes the last copy of the pipe's write end, so the reader
+     * sees end-of-file once it's caught up.
+     */
+    ~StdoutRedirect() {
+      cout.flush();
+      fflush(stdout);
+
+      dup2(savedStdout, STDOUT_FILENO);
+      close(savedStdout);
+
+      reader.join();
+      close(readEnd);
+    }
+
+  private:
+    int savedStdout;
+    int readEnd;
+    thread reader;
+  };
+}
+
+OutputComparison Compare::exactly() {
+  return OutputComparison();
+}
+
+OutputComparison Compare::ignoringWhitespace() {
+  OutputComparison result;
+  result.ignoreWhitespace = true;
+  return result;
+}
+
+OutputComparison Compare::withTolerance(double tolerance) {
+  if (!(tolerance >= 0)) throw invalid_argument("Tolerance must be nonnegative.");
+
+  OutputComparison result;
+  result.ignoreWhitespace = true;
+  result.compareNumbers   = true;
+  result.tolerance        = tolerance;
+  return result;
+}
+
+void doExpectOutputMatchesFile(const function<void ()>& code, const string& goldenFile,
+                               const OutputComparison& comparison, const char* expression,
+                               size_t line, const char* filename) {
+  MappedFile expected(goldenFile);
+  if (!expected.valid()) doInternalError("Cannot open " + goldenFile + ".", line, filename);
+
+  OutputMatcher matcher(expected.data(), expected.size(), comparison);
+  {
+    StdoutRedirect redirect(matcher, line, filename);
+    code();
+  }
+  if (matcher.finish()) return;
+
+  const auto& difference = matcher.firstDifference();
+  ostringstream message;
+  message << "Output of " << expression << " doesn't match " << goldenFile
+          << ", starting at line " << difference.lineNumber << "." << '\n';
+  for (const auto& context: difference.context) {
+    message << "            " << shown(context) << '\n';
+  }
+  message << "  Expected: " << (difference.expectedEnded? "(end of output)" : shown(difference.expected)) << '\n'
+          << "  Printed:  " << (difference.actualEnded?   "(end of output)" : shown(difference.actual));
+  doFailTestVisibly(message.str(), line, filename);
+}
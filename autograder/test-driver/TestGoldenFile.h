@@ -0,0 +1,33 @@
+/* Functions for checking what a piece of code prints against a file of expected output (a
+ * "golden file"). The output is compared as it's produced, against a memory-mapped copy of
+ * the file, so neither one ever has to be held in memory in full. This keeps tests of
+ * programs that print megabytes of output fast.
+ */
+
+#ifndef TestGoldenFile_Included
+#define TestGoldenFile_Included
+
+/* How closely output has to match the golden file. */
+struct OutputComparison {
+  bool   ignoreWhitespace = false; // Compare lines word by word, skipping blank lines.
+  bool   compareNumbers   = false; // Compare numeric words up to a tolerance (implies the above).
+  double tolerance        = 0;
+};
+
+namespace Compare {
+  /* Output has to match byte for byte. */
+  OutputComparison exactly();
+
+  /* Output has to have the same words on each line, but how they're spaced doesn't matter,
+   * and neither do blank lines.
+   */
+  OutputComparison ignoringWhitespace();
+
+  /* As with ignoringWhitespace, but words that are numbers only need to be within the given
+   * tolerance of the expected number. The tolerance is absolute for numbers smaller than one
+   * and relative for bigger numbers.
+   */
+  OutputComparison withTolerance(double tolerance);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "TestMetrics.h"
+#include "TestCommon.h"
+#include "TestStages.h"
+#include <sys/resource.h>
+#include <fstream>
+#include <iomanip>
+using namespace std;
+
+namespace {
+  /* Upper bounds, in seconds, of the buckets in the test duration histogram. */
+  const vector<double> kDurationBounds = {
+    0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60
+  };
+
+  /* Every Result, paired with its name as a label value. */
+  const vector<pair<Result, string>> kResultNames = {
+    { Result::PASS,           "pass"           },
+    { Result::FAIL,           "fail"           },
+    { Result::VISIBLE_FAIL,   "visible_fail"   },
+    { Result::EXCEPTION,      "exception"      },
+    { Result::CRASH,          "crash"          },
+    { Result::TIMEOUT,        "timeout"        },
+    { Result::INTERNAL_ERROR, "internal_error" },
+  };
+
+  /* Prefix for all our metric names. */
+  const string kPrefix = "autograder_run_tests_";
+
+  /* Writes the # TYPE and # HELP lines that introduce a metric family. */
+  void describe(ostream& out, const string& name, const string& type, const string& help) {
+    out << "# TYPE " << kPrefix << name << " " << type << '\n'
+        << "# HELP " << kPrefix << name << " " << help << '\n';
+  }
+
+  /* Label values can't contain quotes, backslashes, or newlines as-is. */
+  string escapeLabel(const string& value) {
+    string result;
+    for (char ch: value) {
+      if (ch == '\\' || ch == '"') result += '\\';
+      if (ch == '\n') result += "\\n";
+      else            result += ch;
+    }
+    return result;
+  }
+
+  /* Peak resident memory, in bytes, of this process or of the largest test process. */
+  long peakMemory(int who) {
+    struct rusage usage;
+    if (getrusage(who, &usage) == -1) return 0;
+    return usage.ru_maxrss * 1024L; // Linux reports this in kilobytes
+  }
+}
+
+RunMetrics& runMetrics() {
+  static RunMetrics theMetrics;
+  return theMetrics;
+}
+
+RunMetrics::RunMetrics() : resultCounts(kResultNames.size()), durationBuckets(kDurationBounds.size()) {
+
+}
+
+void RunMetrics::recordTest(Result result, double seconds) {
+  lock_guard<mutex> guard(lock);
+
+  size_t index = static_cast<size_t>(result);
+  if (index < resultCounts.size()) resultCounts[index]++;
+
+  for (size_t i = 0; i < kDurationBounds.size(); i++) {
+    if (seconds <= kDurationBounds[i]) durationBuckets[i]++;
+  }
+  numTests++;
+  testSeconds += seconds;
+}
+
+void RunMetrics::recordFork(double seconds) {
+  lock_guard<mutex> guard(lock);
+  forks.count++;
+  forks.seconds += seconds;
+}
+
+void RunMetrics::recordReap(double seconds) {
+  lock_guard<mutex> guard(lock);
+  reaps.count++;
+  reaps.seconds += seconds;
+}
+
+void RunMetrics::save(const string& filename) const {
+  lock_guard<mutex> guard(lock);
+
+  ofstream out(filename);
+  if (!out) emergencyAbort("Could not open file " + filename + " for writing.");
+  out << setprecision(9);
+
+  describe(out, "tests", "gauge", "Test cases run, by how they turned out.");
+  for (const auto& result: kResultNames) {
+    out << kPrefix << "tests{result=\"" << result.second << "\"} "
+        << resultCounts[static_cast<size_t>(result.first)] << '\n';
+  }
+
+  describe(out, "test_duration_seconds", "histogram", "How long each test case took, including its process.");
+  for (size_t i = 0; i < kDurationBounds.size(); i++) {
+    out << kPrefix << "test_duration_seconds_bucket{le=\"" << kDurationBounds[i] << "\"} "
+        << durationBuckets[i] << '\n';
+  }
+  out << kPrefix << "test_duration_seconds_bucket{le=\"+Inf\"} " << numTests    << '\n'
+      << kPrefix << "test_duration_seconds_count "               << numTests    << '\n'
+      << kPrefix << "test_duration_seconds_sum "                 << testSeconds << '\n';
+
+  describe(out, "fork_seconds", "summary", "Time spent forking test processes.");
+  out << kPrefix << "fork_seconds_count " << forks.count   << '\n'
+      << kPrefix << "fork_seconds_sum "   << forks.seconds << '\n';
+
+  describe(out, "reap_seconds", "summary", "Time spent waiting for finished test processes to exit.");
+  out << kPrefix << "reap_seconds_count " << reaps.count   << '\n'
+      << kPrefix << "reap_seconds_sum "   << reaps.seconds << '\n';
+
+  describe(out, "stage_seconds", "gauge", "Time spent in each stage of the run.");
+  for (const auto& stage: stageTimings().allStages()) {
+    out << kPrefix << "stage_seconds{stage=\"" << escapeLabel(stage.first) << "\"} "
+        << stage.second << '\n';
+  }
+
+  describe(out, "peak_memory_bytes", "gauge", "Peak resident memory of the driver and of the largest test process.");
+  out << kPrefix << "peak_memory_bytes{process=\"driver\"} " << peakMemory(RUSAGE_SELF)     << '\n'
+      << kPrefix << "peak_memory_bytes{process=\"test\"} "   << peakMemory(RUSAGE_CHILDREN) << '\n';
+
+  out << "# EOF" << '\n';
+}
@@ -0,0 +1,50 @@
+/* Statistics about a run of the test driver: how the tests turned out, how long they took,
+ * what it cost to fork and reap the processes they ran in, and how much memory everything
+ * used. These are written out by --metrics in the OpenMetrics text format, one file per run,
+ * so that a collector can aggregate them across many runs.
+ */
+
+#ifndef TestMetrics_Included
+#define TestMetrics_Included
+
+#include "TestResult.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+class RunMetrics {
+public:
+  RunMetrics();
+
+  /* Records that a test case took the given number of seconds and how it turned out. */
+  void recordTest(Result result, double seconds);
+
+  /* Records how long the driver spent forking a test's process, and how long it then spent
+   * waiting to reap that process once the test was over.
+   */
+  void recordFork(double seconds);
+  void recordReap(double seconds);
+
+  /* Writes out everything recorded, along with the stage timings and peak memory use. */
+  void save(const std::string& filename) const;
+
+private:
+  /* Running totals for the overhead of managing test processes. */
+  struct Overhead {
+    std::size_t count   = 0;
+    double      seconds = 0;
+  };
+
+  mutable std::mutex lock;
+  std::vector<std::size_t> resultCounts;    // Indexed by Result
+  std::vector<std::size_t> durationBuckets; // Tests no slower than each bucket's bound
+  std::size_t numTests = 0;
+  double testSeconds = 0;
+  Overhead forks, reaps;
+};
+
+/* Returns the metrics for this run. */
+RunMetrics& runMetrics();
+
+#endif
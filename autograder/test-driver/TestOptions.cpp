@@ -0,0 +1,11 @@
+#include "TestOptions.h"
+
+TestOptions& testOptions() {
+  static TestOptions theOptions;
+  return theOptions;
+}
+
+double TestOptions::timeoutFor(const std::string& key) const {
+  auto itr = timeouts.find(key);
+  return itr == timeouts.end()? defaultTimeout : itr->second;
+}
@@ -0,0 +1,92 @@
+/* Settings that control how tests are run. These are filled in from the command-line
+ * arguments to run-tests before any tests execute.
+ */
+
+#ifndef TestOptions_Included
+#define TestOptions_Included
+
+#include <cstddef>
+#include <string>
+#include <map>
+#include <set>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+
+struct TestOptions {
+  /* Maximum number of bytes of each test's stdout/stderr to hold on to. Anything
+   * before the last outputLimit bytes is discarded.
+   */
+  std::size_t outputLimit = 64 * 1024;
+  
+  /* Whether to show students the captured output of failed tests in public groups. */
+  bool showOutput = false;
+  
+  /* How many tests to run at once. */
+  std::size_t numJobs = 1;
+  
+  /* Whether to report the predicted and actual time taken to run all the tests. */
+  bool reportSchedule = false;
+  
+  /* How many seconds a test may run before it's considered to have timed out, unless it
+   * has a timeout of its own.
+   */
+  double defaultTimeout = 60;
+  
+  /* Timeouts for individual tests, keyed by their full names, as loaded from a
+   * calibration file.
+   */
+  std::map<std::string, double> timeouts;
+  
+  /* The calibration file those came from, if there was one. */
+  std::string calibrationFile;
+  
+  /* How calibration turns the time the reference solution takes into a timeout: the
+   * median of calibrationRuns runs, times timeoutMultiplier, plus timeoutFloor seconds.
+   */
+  std::size_t calibrationRuns = 5;
+  double timeoutMultiplier = 3;
+  double timeoutFloor = 1;
+  
+  /* Whether to run tests inside the driver rather than in child processes. This is for
+   * quickly trying out tests against a known-good solution; it isn't safe for grading.
+   */
+  bool noFork = false;
+  
+  /* If nonempty, only test groups defined in these source files are run. */
+  std::set<std::string> sourceFiles;
+  
+  /* Which of numShards shards of the test groups to run, counting from zero. Groups are
+   * dealt out so that each shard gets about the same number of tests.
+   */
+  std::size_t shard = 0;
+  std::size_t numShards = 1;
+  
+  /* How long to keep a timing-sensitive test's CPU busy before starting the test. */
+  std::chrono::milliseconds timingWarmup{0};
+  
+  /* Limits on how much checking CHECK_AGAINST_REFERENCE does: it stops after trying
+   * propertyCases inputs or after propertyBudget seconds, whichever comes first. Shrinking
+   * an input it finds gets another propertyBudget seconds.
+   */
+  std::size_t propertyCases = 10000;
+  double propertyBudget = 2.0;
+  
+  /* Seed for CHECK_AGAINST_REFERENCE's random inputs. If there isn't one, each check picks
+   * a seed of its own and reports it if the check fails.
+   */
+  std::optional<std::uint64_t> propertySeed;
+  
+  /* Directory of files for tests to read and write. If there is one, each test runs in a
+   * scratch directory of its own that starts out holding these files (see TestScratch.h).
+   */
+  std::string testData;
+  
+  /* Returns the timeout for the test with the given key. */
+  double timeoutFor(const std::string& key) const;
+};
+
+/* Returns the options in effect for this run. */
+TestOptions& testOptions();
+
+#endif
@@ -0,0 +1,66 @@
+#include "TestOutcomes.h"
+#include "TestCommon.h"
+#include "TestOptions.h"
+#include "JSON.h"
+#include <fstream>
+#include <map>
+using namespace std;
+
+void saveOutcomes(const string& filename, const vector<ScheduledTest>& work, const Outcomes& outcomes) {
+  map<string, JSON> data;
+  for (const auto& test: work) {
+    auto outcome = outcomes.find(test.test.get());
+    if (outcome == outcomes.end()) continue;
+
+    auto result = dynamic_pointer_cast<SingleTestResult>(outcome->second);
+    if (!result) continue;
+
+    data.insert(make_pair(test.key, JSON::object({
+      { "result",     static_cast<int>(result->status()) },
+      { "message",    result->statusMessage()            },
+      { "output",     result->capturedOutput()           },
+      { "checkpoint", result->lastCheckpoint()           },
+      { "earned",     result->score().earned             },
+      { "sanitizer",  result->sanitizerFindings()        },
+    })));
+  }
+
+  ofstream output(filename);
+  if (!output) emergencyAbort("Could not open file " + filename + " for writing.");
+  output << JSON(data);
+}
+
+Outcomes loadOutcomes(const string& filename, const vector<ScheduledTest>& work) {
+  ifstream input(filename);
+  if (!input) return {};
+
+  map<string, JSON> saved;
+  JSON data = JSON::parse(input);
+  for (auto key: data) {
+    saved.insert(make_pair(key.asString(), data[key]));
+  }
+
+  Outcomes outcomes;
+  for (const auto& test: work) {
+    auto entry = saved.find(test.key);
+    if (entry == saved.end()) continue;
+
+    /* Anything we can't make sense of is better off run again. */
+    const JSON& fields = entry->second;
+    double status = fields["result"].asDouble();
+    if (status < 0 || status > static_cast<int>(Result::INTERNAL_ERROR)) continue;
+
+    auto result = make_shared<SingleTestResult>(static_cast<Result>(status),
+                                                fields["message"].asString(),
+                                                test.test->pointsPossible(), test.test->name(),
+                                                fields["output"].asString(),
+                                                testOptions().showOutput,
+                                                fields["checkpoint"].asString(),
+                                                Points(fields["earned"].asDouble()));
+    if (!fields["sanitizer"].asString().empty()) {
+      result->attachSanitizerReport(fields["sanitizer"].asString());
+    }
+    outcomes[test.test.get()] = result;
+  }
+  return outcomes;
+}
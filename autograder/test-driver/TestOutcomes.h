@@ -0,0 +1,22 @@
+/* Saving and reloading how test cases turned out. When only some of the tests could have
+ * been affected by a change, the rest can report their results from the last run rather
+ * than being run again.
+ */
+
+#ifndef TestOutcomes_Included
+#define TestOutcomes_Included
+
+#include "Test.h"
+#include <string>
+#include <vector>
+
+/* Writes out the outcome of each of the given test cases, keyed by their full names. */
+void saveOutcomes(const std::string& filename, const std::vector<ScheduledTest>& work,
+                  const Outcomes& outcomes);
+
+/* Loads saved outcomes for whichever of the given test cases have them. A missing file
+ * counts as having none.
+ */
+Outcomes loadOutcomes(const std::string& filename, const std::vector<ScheduledTest>& work);
+
+#endif
@@ -0,0 +1,114 @@
+#include "TestProperty.h"
+#include "TestCase.h"
+#include "TestChannel.h"
+#include "TestOptions.h"
+#include <random>
+using namespace std;
+
+namespace {
+  /* Most shrink steps to take before settling for the input we have. Each step calls both
+   * functions once, so this and the time limit keep a slow function from shrinking forever.
+   */
+  const size_t kMaxShrinkSteps = 10000;
+
+  chrono::steady_clock::time_point secondsFromNow(double seconds) {
+    return chrono::steady_clock::now() +
+           chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+  }
+}
+
+/* * * * * Generators * * * * */
+Generator<bool> Gen::booleans() {
+  Generator<bool> result;
+  result.generate = [](mt19937_64& random, size_t) {
+    return bernoulli_distribution()(random);
+  };
+  result.shrink = [](bool value) {
+    return value? vector<bool>{ false } : vector<bool>();
+  };
+  return result;
+}
+
+Generator<string> Gen::strings(size_t maxLength, const string& alphabet) {
+  if (alphabet.empty()) throw invalid_argument("Can't generate strings from an empty alphabet.");
+  
+  Generator<string> result;
+  result.generate = [=](mt19937_64& random, size_t size) {
+    size_t length = uniform_int_distribution<size_t>(0, min(size, maxLength))(random);
+    uniform_int_distribution<size_t> letter(0, alphabet.size() - 1);
+    
+    string value;
+    for (size_t i = 0; i < length; i++) {
+      value += alphabet[letter(random)];
+    }
+    return value;
+  };
+  
+  /* Shorter strings first, then strings using letters earlier in the alphabet. */
+  result.shrink = [=](const string& value) {
+    vector<string> candidates;
+    if (value.size() > 1) {
+      candidates.push_back(value.substr(0, value.size() / 2));
+      candidates.push_back(value.substr(value.size() / 2));
+    }
+    for (size_t i = 0; i < value.size(); i++) {
+      candidates.push_back(value.substr(0, i) + value.substr(i + 1));
+    }
+    for (size_t i = 0; i < value.size(); i++) {
+      if (value[i] != alphabet[0]) {
+        auto candidate = value;
+        candidate[i] = alphabet[0];
+        candidates.push_back(candidate);
+      }
+    }
+    return candidates;
+  };
+  return result;
+}
+
+/* * * * * PropertyRun Implementation * * * * */
+PropertyRun::PropertyRun() {
+  auto& options = testOptions();
+  
+  if (options.propertySeed) {
+    theSeed = *options.propertySeed;
+  } else {
+    random_device device;
+    theSeed = (uint64_t(device()) << 32) | device();
+  }
+  
+  deadline = secondsFromNow(options.propertyBudget);
+  logToDriver("  Checking random inputs against the reference (seed " + to_string(theSeed) + ").");
+}
+
+uint64_t PropertyRun::seed() const {
+  return theSeed;
+}
+
+bool PropertyRun::keepGoing(size_t casesRun) const {
+  return casesRun < testOptions().propertyCases && chrono::steady_clock::now() < deadline;
+}
+
+void PropertyRun::startShrinking() {
+  shrinkDeadline = secondsFromNow(testOptions().propertyBudget);
+}
+
+bool PropertyRun::keepShrinking(size_t steps) {
+  if (steps < kMaxShrinkSteps && chrono::steady_clock::now() < shrinkDeadline) return true;
+  
+  cutShort = true;
+  return false;
+}
+
+void PropertyRun::passed(size_t casesRun) const {
+  logToDriver("  Checked " + to_string(casesRun) + " random inputs against the reference.");
+}
+
+void PropertyRun::failed(const string& description, size_t casesRun, size_t shrinkSteps,
+                         size_t line, const char* filename) const {
+  logToDriver("  Found a difference from the reference after " + to_string(casesRun) +
+              " inputs; shrank it in " + to_string(shrinkSteps) + " steps" +
+              (cutShort? " before running out of time." : "."));
+  doFailTest(description + " (Reproduce with --property-seed " + to_string(theSeed) + ".)",
+             line, filename);
+}
@@ -0,0 +1,283 @@
+/* Differential testing: running a student's function and a reference implementation on lots
+ * of randomly generated inputs and checking that they agree. When they don't, the input is
+ * shrunk down to a small example that still shows the difference.
+ *
+ * Inputs come from a Generator, which knows how to make random values and how to find
+ * "smaller" versions of a value for shrinking. The Gen namespace has generators for common
+ * types, which can be combined:
+ *
+ *    Gen::vectorsOf(Gen::integers(-100, 100))
+ *    Gen::tuplesOf(Gen::strings(10), Gen::integers(0, 5))
+ *
+ * For a function of several arguments, generate a tuple; its parts are passed as separate
+ * arguments.
+ */
+
+#ifndef TestProperty_Included
+#define TestProperty_Included
+
+#include "TestFormatting.h"
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <tuple>
+#include <optional>
+#include <exception>
+#include <cstdint>
+#include <cstddef>
+
+/* A way to make random values of some type. The size parameter, which starts at zero and
+ * grows as testing goes on, says roughly how big a value to make, so that small inputs are
+ * tried first. shrink returns candidates that are simpler than the given value, simplest
+ * first.
+ */
+template <typename T> struct Generator {
+  std::function<T (std::mt19937_64& random, std::size_t size)> generate;
+  std::function<std::vector<T> (const T& value)> shrink = [](const T&) { return std::vector<T>(); };
+};
+
+namespace Gen {
+  /* Integers in [low, high], shrinking toward whichever value in range is closest to zero. */
+  template <typename T> Generator<T> integers(T low, T high) {
+    T target = low > 0? low : high < 0? high : 0;
+    
+    Generator<T> result;
+    result.generate = [=](std::mt19937_64& random, std::size_t) {
+      /* Bugs cluster at the edges, so we try those every so often. */
+      switch (std::uniform_int_distribution<int>(0, 7)(random)) {
+        case 0:  return low;
+        case 1:  return high;
+        case 2:  return target;
+        default: return std::uniform_int_distribution<T>(low, high)(random);
+      }
+    };
+    result.shrink = [=](T value) {
+      std::vector<T> candidates;
+      if (value == target) return candidates;
+      
+      candidates.push_back(target);
+      T halfway = target + (value - target) / 2;
+      if (halfway != target && halfway != value) candidates.push_back(halfway);
+      candidates.push_back(value > target? value - 1 : value + 1);
+      return candidates;
+    };
+    return result;
+  }
+  
+  /* true or false, shrinking toward false. */
+  Generator<bool> booleans();
+  
+  /* Strings of up to maxLength characters drawn from the alphabet. */
+  Generator<std::string> strings(std::size_t maxLength,
+                                 const std::string& alphabet = "abcdefghijklmnopqrstuvwxyz");
+  
+  /* One of the given values, shrinking toward the ones listed first. */
+  template <typename T> Generator<T> oneOf(const std::vector<T>& values) {
+    Generator<T> result;
+    result.generate = [=](std::mt19937_64& random, std::size_t) {
+      return values[std::uniform_int_distribution<std::size_t>(0, values.size() - 1)(random)];
+    };
+    result.shrink = [=](const T& value) {
+      std::vector<T> candidates;
+      for (const auto& candidate: values) {
+        if (candidate == value) break;
+        candidates.push_back(candidate);
+      }
+      return candidates;
+    };
+    return result;
+  }
+  
+  /* Vectors of up to maxSize elements. Shrinking removes elements, then shrinks them. */
+  template <typename T> Generator<std::vector<T>> vectorsOf(Generator<T> element,
+                                                            std::size_t maxSize = 100) {
+    Generator<std::vector<T>> result;
+    result.generate = [=](std::mt19937_64& random, std::size_t size) {
+      std::size_t length = std::uniform_int_distribution<std::size_t>(0, std::min(size, maxSize))(random);
+      std::vector<T> value;
+      for (std::size_t i = 0; i < length; i++) {
+        value.push_back(element.generate(random, size));
+      }
+      return value;
+    };
+    result.shrink = [=](const std::vector<T>& value) {
+      std::vector<std::vector<T>> candidates;
+      
+      /* Big cuts first: drop each half. */
+      if (value.size() > 1) {
+        candidates.emplace_back(value.begin(), value.begin() + value.size() / 2);
+        candidates.emplace_back(value.begin() + value.size() / 2, value.end());
+      }
+      for (std::size_t i = 0; i < value.size(); i++) {
+        auto smaller = value;
+        smaller.erase(smaller.begin() + i);
+        candidates.push_back(smaller);
+      }
+      for (std::size_t i = 0; i < value.size(); i++) {
+        for (const auto& simpler: element.shrink(value[i])) {
+          auto candidate = value;
+          candidate[i] = simpler;
+          candidates.push_back(candidate);
+        }
+      }
+      return candidates;
+    };
+    return result;
+  }
+  
+  /* Helper for tuplesOf: shrinks each part of a tuple in turn. */
+  template <typename Tuple, typename Generators, std::size_t... Indices>
+  void shrinkParts(const Tuple& value, std::vector<Tuple>& candidates, const Generators& generators,
+                   std::index_sequence<Indices...>) {
+    auto shrinkPart = [&](auto index) {
+      for (const auto& simpler: std::get<index>(generators).shrink(std::get<index>(value))) {
+        auto candidate = value;
+        std::get<index>(candidate) = simpler;
+        candidates.push_back(candidate);
+      }
+    };
+    (shrinkPart(std::integral_constant<std::size_t, Indices>()), ...);
+  }
+
+  /* Tuples with each part drawn from its own generator. Shrinking shrinks one part at a time. */
+  template <typename... Ts> Generator<std::tuple<Ts...>> tuplesOf(Generator<Ts>... parts) {
+    Generator<std::tuple<Ts...>> result;
+    result.generate = [=](std::mt19937_64& random, std::size_t size) {
+      /* Braces make sure the parts are generated in order. */
+      return std::tuple<Ts...>{ parts.generate(random, size)... };
+    };
+    result.shrink = [=](const std::tuple<Ts...>& value) {
+      std::vector<std::tuple<Ts...>> candidates;
+      shrinkParts(value, candidates, std::make_tuple(parts...), std::index_sequence_for<Ts...>());
+      return candidates;
+    };
+    return result;
+  }
+  
+}
+
+/* Keeps track of one run of CHECK_AGAINST_REFERENCE: which seed it uses, and when to stop.
+ * The seed is logged as soon as the run starts, so that it's on record even if the function
+ * being checked crashes or hangs.
+ */
+class PropertyRun {
+public:
+  PropertyRun();
+  
+  /* Seed for the random number generator. */
+  std::uint64_t seed() const;
+  
+  /* Returns whether to try another case, given how many have run. */
+  bool keepGoing(std::size_t casesRun) const;
+  
+  /* Starts the clock on shrinking an input the functions disagree on. */
+  void startShrinking();
+  
+  /* Returns whether to try another shrink step, given how many have run. */
+  bool keepShrinking(std::size_t steps);
+  
+  /* Records that every case passed. */
+  void passed(std::size_t casesRun) const;
+  
+  /* Fails the test, reporting the smallest input found. */
+  [[ noreturn ]] void failed(const std::string& description, std::size_t casesRun,
+                             std::size_t shrinkSteps, std::size_t line, const char* filename) const;
+  
+private:
+  std::uint64_t theSeed;
+  std::chrono::steady_clock::time_point deadline;
+  std::chrono::steady_clock::time_point shrinkDeadline;
+  bool cutShort = false;
+};
+
+namespace TestPropertyDetail {
+  /* What happened when a function was called: either it returned a value, or it threw. */
+  template <typename R> struct Outcome {
+    std::optional<R> value;
+    std::string      exception;
+  };
+  
+  /* Calls a function on an input, passing the parts of a tuple as separate arguments if the
+   * function doesn't take the tuple itself. The function gets its own copy of the input.
+   */
+  template <typename Function, typename T> auto invoke(Function& function, T input) {
+    if constexpr (std::is_invocable_v<Function&, T&>) {
+      return function(input);
+    } else {
+      return std::apply(function, input);
+    }
+  }
+  
+  template <typename Function, typename T> auto outcomeOf(Function& function, const T& input) {
+    Outcome<std::decay_t<decltype(invoke(function, input))>> result;
+    try {
+      result.value = invoke(function, input);
+    } catch (const std::exception& e) {
+      result.exception = std::string("threw an exception: ") + e.what();
+    } catch (...) {
+      result.exception = "threw an exception";
+    }
+    return result;
+  }
+  
+  template <typename R> std::string describe(const Outcome<R>& outcome) {
+    return outcome.value? "returned " + formatForTest(*outcome.value) : outcome.exception;
+  }
+}
+
+/* Implementation of CHECK_AGAINST_REFERENCE. */
+template <typename Function, typename Reference, typename T>
+void doCheckAgainstReference(Function function, Reference reference, const Generator<T>& generator,
+                             std::size_t line, const char* filename) {
+  using namespace TestPropertyDetail;
+  
+  /* Returns whether the two functions disagree on an input, and if so, how. */
+  auto disagree = [&](const T& input, std::string& description) {
+    auto expected = outcomeOf(reference, input);
+    auto actual   = outcomeOf(function,  input);
+    
+    bool same = expected.value? actual.value && *actual.value == *expected.value : !actual.value;
+    if (!same) {
+      description = "On input " + formatForTest(input) + ", the function " + describe(actual) +
+                    ", but the reference " + describe(expected) + ".";
+    }
+    return !same;
+  };
+  
+  PropertyRun run;
+  std::mt19937_64 random(run.seed());
+  
+  std::size_t casesRun = 0;
+  for (; run.keepGoing(casesRun); casesRun++) {
+    T input = generator.generate(random, casesRun % 101);
+    
+    std::string description;
+    if (!disagree(input, description)) continue;
+    
+    /* Found a difference. Keep taking the first simpler input that still shows it, until
+     * there isn't one or we run out of time, and report whatever we ended up with.
+     */
+    run.startShrinking();
+    std::size_t steps = 0;
+    for (bool progress = true; progress; ) {
+      progress = false;
+      for (const auto& candidate: generator.shrink(input)) {
+        if (!run.keepShrinking(steps++)) break;
+        
+        if (disagree(candidate, description)) {
+          input    = candidate;
+          progress = true;
+          break;
+        }
+      }
+    }
+    run.failed(description, casesRun + 1, steps, line, filename);
+  }
+  
+  run.passed(casesRun);
+}
+
+#endif
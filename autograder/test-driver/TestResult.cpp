@@ -52,9 +52,11 @@ size_t TestResult::numTests() const {
 /* * * * * SingleTestResult * * * * */
 
 SingleTestResult::SingleTestResult(Result result, const std::string& message,
-                                   Points possible, const string& name)
-  : TestResult({ (result == Result::PASS) * possible, possible }, name, result == Result::PASS, 1),
-    result(result), message(message) {
+                                   Points possible, const string& name,
+                                   const string& output, bool showOutput,
+                                   const string& checkpoint, Points partialCredit)
+  : TestResult({ result == Result::PASS? possible : partialCredit, possible }, name, result == Result::PASS, 1),
+    result(result), message(message), output(output), showOutput(showOutput), checkpoint(checkpoint) {
 }
 
 /* Our display text is the default, plus a status message. */
@@ -70,17 +72,66 @@ string SingleTestResult::displayText() const {
   return builder.str();
 }
 
-/* We report failures by including ourself and our status if we didn't pass. */
+/* We report failures by including ourself and our status if we didn't pass, along with
+ * what we printed if that's supposed to be shown.
+ */
 set<string> SingleTestResult::reportFailedTests() const {
   if (result == Result::PASS) {
     return { };
   }
-  return { name() + " (" + humanReadableMessage() + ")" };
+  
+  ostringstream report;
+  report << name() << " (" << humanReadableMessage() << ")";
+  
+  if (!sanitizerReport.empty()) {
+    report << endl << "    Sanitizer report:";
+    
+    istringstream lines(sanitizerReport);
+    for (string line; getline(lines, line); ) {
+      report << endl << "      " << line;
+    }
+  }
+  
+  if (showOutput && !output.empty()) {
+    report << endl << "    Output:";
+    
+    istringstream lines(output);
+    for (string line; getline(lines, line); ) {
+      report << endl << "      " << line;
+    }
+  }
+  
+  return { report.str() };
+}
+
+string SingleTestResult::capturedOutput() const {
+  return output;
+}
+
+Result SingleTestResult::status() const {
+  return result;
+}
+
+string SingleTestResult::statusMessage() const {
+  return message;
+}
+
+string SingleTestResult::lastCheckpoint() const {
+  return checkpoint;
+}
+
+string SingleTestResult::sanitizerFindings() const {
+  return sanitizerReport;
+}
+
+void SingleTestResult::attachSanitizerReport(const string& report) {
+  sanitizerReport = report;
 }
 
 /* Human-readable version of our status. */
 string SingleTestResult::humanReadableMessage() const {
   if (result == Result::VISIBLE_FAIL) return message;
+  else if (!checkpoint.empty()) return to_string(result) + " after \"" + checkpoint + "\"";
   else return to_string(result);
 }
 
@@ -163,3 +214,18 @@ set<string> MissingFileTestResult::reportFailedTests() const {
 string MissingFileTestResult::displayText() const {
   return "Tests not run; not all necessary files were submitted.";
 }
+
+
+/* * * * * Fixture Failed Test Results * * * * */
+FixtureFailedTestResult::FixtureFailedTestResult(Points pointsPossible, const std::string& name)
+  : TestResult({ 0, pointsPossible }, name, 0, 0) {
+
+}
+
+set<string> FixtureFailedTestResult::reportFailedTests() const {
+  return { "(tests not run; test setup failed)" };
+}
+
+string FixtureFailedTestResult::displayText() const {
+  return "Tests not run; the setup they depend on failed. Please contact the course staff.";
+}
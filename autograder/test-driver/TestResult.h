@@ -77,15 +77,41 @@ private:
 class SingleTestResult: public TestResult {
 public:
   SingleTestResult(Result result, const std::string& message, // Can be empty
-                   Points possible, const std::string& name);
+                   Points possible, const std::string& name,
+                   const std::string& output = "",              // What the test printed
+                   bool showOutput = false,                     // Whether students see it
+                   const std::string& checkpoint = "",          // Last phase finished, if cut short
+                   Points partialCredit = 0);                   // Earned if it didn't pass
   std::set<std::string> reportFailedTests() const override;
   
   /* Displays what happened with this test. */
   virtual std::string displayText() const;
   
+  /* Returns whatever the test wrote to stdout and stderr, possibly truncated. */
+  std::string capturedOutput() const;
+  
+  /* Returns how the test ended. */
+  Result status() const;
+  
+  /* Returns the message the test ended with, if any. */
+  std::string statusMessage() const;
+  
+  /* Returns the last checkpoint the test reached, if it was cut short. */
+  std::string lastCheckpoint() const;
+  
+  /* Returns what the sanitizers found, if the test was run under them. */
+  std::string sanitizerFindings() const;
+  
+  /* Adds what the sanitizers found when this test was run again under them. */
+  void attachSanitizerReport(const std::string& report);
+  
 private:
   Result result;
   std::string message;
+  std::string output;
+  bool showOutput;
+  std::string checkpoint;
+  std::string sanitizerReport;
   
   /* Produces a display message containing the result of this test. */
   std::string humanReadableMessage() const;
@@ -124,4 +150,12 @@ public:
   std::string displayText() const override;
 };
 
+/* Test result indicating that tests weren't run because a group fixture couldn't be set up. */
+class FixtureFailedTestResult: public TestResult {
+public:
+  FixtureFailedTestResult(Points pointsPossible, const std::string& name);
+  std::set<std::string> reportFailedTests() const override;
+  std::string displayText() const override;
+};
+
 #endif
@@ -0,0 +1,218 @@
+#include "TestSanitizer.h"
+#include "TestCommon.h"
+#include "TestOptions.h"
+#include "TestScheduler.h"
+#include "TestTimings.h"
+#include "JSON.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <set>
+using namespace std;
+
+namespace {
+  /* How much longer than usual tests get under the sanitizers, which slow things down. */
+  const double kSanitizerSlowdown = 3;
+
+  /* How long to wait for the sanitized runner to be built before giving up. */
+  const chrono::minutes kMaxBuildWait(5);
+
+  /* How often to check whether it's been built. */
+  const chrono::milliseconds kBuildPollInterval(100);
+
+  /* Most lines of sanitizer output to keep for each test. */
+  const size_t kMaxReportLines = 8;
+
+  /* Where the request and report files go, next to the runner. */
+  const string kRequestFile = ".autograder.sanitizer-request.json";
+  const string kReportFile  = ".autograder.sanitizer-report.json";
+
+  /* The command that reruns the requested tests. Anything that changes how a test behaves
+   * is passed along, so that the rerun fails the way the original run did. The runner works
+   * in its own directory, so paths are made absolute.
+   */
+  vector<string> rerunCommand(const string& runner, const string& missingList) {
+    const auto& options = testOptions();
+    vector<string> result = {
+      runner,
+      "--sanitizer-check", kRequestFile,
+      "-o", kReportFile,
+      "-m", filesystem::absolute(missingList).string(),
+      "-p", to_string(options.numJobs),
+      "--output-limit",    to_string(options.outputLimit),
+      "--timing-warmup",   to_string(options.timingWarmup.count()),
+      "--property-cases",  to_string(options.propertyCases),
+      "--property-budget", to_string(options.propertyBudget)
+    };
+    if (options.propertySeed) {
+      result.insert(result.end(), { "--property-seed", to_string(*options.propertySeed) });
+    }
+    if (!options.testData.empty()) {
+      result.insert(result.end(), { "--test-data", filesystem::absolute(options.testData).string() });
+    }
+    if (!options.calibrationFile.empty()) {
+      result.insert(result.end(), { "-c", filesystem::absolute(options.calibrationFile).string() });
+    }
+    return result;
+  }
+
+  /* Returns whether a test that ended this way is worth running again. */
+  bool worthSanitizing(const shared_ptr<TestResult>& result) {
+    auto single = dynamic_pointer_cast<SingleTestResult>(result);
+    if (!single) return false;
+
+    auto status = single->status();
+    return status == Result::CRASH || status == Result::EXCEPTION || status == Result::TIMEOUT;
+  }
+
+  /* Waits until the runner has been built, returning whether it was. */
+  bool waitForRunner(const string& runner) {
+    auto deadline = chrono::steady_clock::now() + kMaxBuildWait;
+    while (chrono::steady_clock::now() < deadline) {
+      if (filesystem::exists(runner))             return true;
+      if (filesystem::exists(runner + ".failed")) return false;
+      this_thread::sleep_for(kBuildPollInterval);
+    }
+    return false;
+  }
+
+  /* Runs a program in the given directory and waits for it, returning whether it exited
+   * successfully. Its output goes straight to ours.
+   */
+  bool runProgram(const vector<string>& command, const string& directory) {
+    vector<char*> args;
+    for (const auto& arg: command) {
+      args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    cout << flush;
+    pid_t pid = fork();
+    if (pid == -1) return false;
+
+    if (pid == 0) {
+      if (chdir(directory.c_str()) == -1) _exit(127);
+      execv(args[0], args.data());
+      _exit(127);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1) return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+
+  /* Pulls the lines that say what went wrong out of a test's output. ASan prefixes its
+   * lines with the process ID, as in "==1234==ERROR: ...", which we strip.
+   */
+  string summarize(const string& output) {
+    const vector<string> markers = {
+      "ERROR: AddressSanitizer", "ERROR: LeakSanitizer", "runtime error:", "SUMMARY:"
+    };
+
+    vector<string> kept;
+    set<string> seen;
+    istringstream lines(output);
+    for (string line; getline(lines, line) && kept.size() < kMaxReportLines; ) {
+      bool relevant = false;
+      for (const auto& marker: markers) {
+        if (line.find(marker) != string::npos) relevant = true;
+      }
+      if (!relevant) continue;
+
+      if (line.compare(0, 2, "==") == 0) {
+        auto end = line.find("==", 2);
+        if (end != string::npos) line = line.substr(end + 2);
+      }
+      if (seen.insert(line).second) kept.push_back(line);
+    }
+
+    ostringstream result;
+    for (const auto& line: kept) {
+      result << line << endl;
+    }
+    return result.str();
+  }
+}
+
+void sanitizeFailures(const vector<ScheduledTest>& work, const Outcomes& outcomes,
+                      const string& runner, const string& missingList) {
+  map<string, JSON> request;
+  for (const auto& test: work) {
+    auto outcome = outcomes.find(test.test.get());
+    if (outcome != outcomes.end() && worthSanitizing(outcome->second)) {
+      request.insert(make_pair(test.key, testOptions().timeoutFor(test.key) * kSanitizerSlowdown));
+    }
+  }
+  if (request.empty()) return;
+
+  cout << "Waiting for the sanitizer build to rerun " << request.size() << " test(s)..." << endl;
+  if (!waitForRunner(runner)) {
+    cout << "The sanitizer build isn't available; skipping the rerun." << endl;
+    return;
+  }
+
+  string directory = filesystem::path(runner).parent_path().string();
+  {
+    ofstream output(directory + "/" + kRequestFile);
+    if (!output) emergencyAbort("Could not open file " + kRequestFile + " for writing.");
+    output << JSON(request);
+  }
+
+  cout << "Rerunning under the sanitizers:" << endl;
+  bool ran = runProgram(rerunCommand(runner, missingList), directory);
+
+  ifstream input(directory + "/" + kReportFile);
+  if (!ran || !input) {
+    cout << "The sanitized runner failed; no reports to attach." << endl;
+    return;
+  }
+
+  JSON data = JSON::parse(input);
+  map<string, string> reports;
+  for (auto key: data) {
+    reports[key.asString()] = data[key].asString();
+  }
+
+  for (const auto& test: work) {
+    auto report = reports.find(test.key);
+    if (report == reports.end() || report->second.empty()) continue;
+
+    auto single = dynamic_pointer_cast<SingleTestResult>(outcomes.at(test.test.get()));
+    if (single) single->attachSanitizerReport(report->second);
+  }
+}
+
+void writeSanitizerReports(const vector<ScheduledTest>& work, const string& requestFile,
+                           const string& reportFile) {
+  ifstream input(requestFile);
+  if (!input) emergencyAbort("Cannot open file " + requestFile + " for reading.");
+  JSON request = JSON::parse(input);
+  set<string> requested;
+  for (auto key: request) {
+    requested.insert(key.asString());
+    testOptions().timeouts[key.asString()] = request[key].asDouble();
+  }
+
+  vector<ScheduledTest> selected;
+  for (const auto& test: work) {
+    if (requested.count(test.key)) selected.push_back(test);
+  }
+
+  TimingDatabase timings;
+  auto outcomes = runScheduled(selected, timings);
+
+  map<string, JSON> reports;
+  for (const auto& test: selected) {
+    auto single = dynamic_pointer_cast<SingleTestResult>(outcomes.at(test.test.get()));
+    reports.insert(make_pair(test.key, single? summarize(single->capturedOutput()) : ""));
+  }
+
+  ofstream output(reportFile);
+  if (!output) emergencyAbort("Could not open file " + reportFile + " for writing.");
+  output << JSON(reports);
+}
@@ -0,0 +1,29 @@
+/* Reruns of misbehaving tests under AddressSanitizer and UndefinedBehaviorSanitizer. The
+ * grading pipeline builds a sanitized copy of run-tests in the background while the tests
+ * run normally. Tests that crash, throw, or time out are then run again using that copy,
+ * and a summary of whatever the sanitizers found is attached to their results. When every
+ * test behaves, the sanitized copy is never waited for.
+ */
+
+#ifndef TestSanitizer_Included
+#define TestSanitizer_Included
+
+#include "Test.h"
+#include <string>
+#include <vector>
+
+/* Runs the tests that misbehaved again using the sanitized runner at the given path, waiting
+ * for it to be built if need be, and attaches the sanitizers' reports to their outcomes. A
+ * file with ".failed" added to the runner's name means it couldn't be built.
+ */
+void sanitizeFailures(const std::vector<ScheduledTest>& work, const Outcomes& outcomes,
+                      const std::string& runner, const std::string& missingList);
+
+/* Program mode for the sanitized runner: runs the tests named in requestFile, which maps
+ * each test's key to its timeout, and writes a JSON object mapping each key to what the
+ * sanitizers reported to reportFile.
+ */
+void writeSanitizerReports(const std::vector<ScheduledTest>& work, const std::string& requestFile,
+                           const std::string& reportFile);
+
+#endif
@@ -0,0 +1,187 @@
+#include "TestScheduler.h"
+#include "TestOptions.h"
+#include "TestMetrics.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <cerrno>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+using namespace std;
+
+namespace {
+  /* Where the lock for each dedicated CPU lives. It's somewhere every run-tests process on
+   * the machine can see, whichever directory it was started in.
+   */
+  string lockFileFor(int cpu) {
+    return "/tmp/run-tests.cpu-" + to_string(cpu) + ".lock";
+  }
+
+  /* Given the expected durations of the tests, in the order they'll be started, returns
+   * how long we expect running them all to take on the given number of workers.
+   */
+  double predictedRunTime(const vector<double>& durations, size_t numWorkers) {
+    /* Each worker picks up the next test as soon as it's free, so we track when each
+     * worker will next become free.
+     */
+    priority_queue<double, vector<double>, greater<double>> freeAt;
+    for (size_t i = 0; i < numWorkers; i++) {
+      freeAt.push(0);
+    }
+
+    double end = 0;
+    for (double duration: durations) {
+      double start = freeAt.top();
+      freeAt.pop();
+      freeAt.push(start + duration);
+      end = max(end, start + duration);
+    }
+    return end;
+  }
+}
+
+mutex& driverOutputLock() {
+  static mutex theLock;
+  return theLock;
+}
+
+int dedicatedCPU() {
+  /* Use the highest-numbered CPU we're allowed on. The kernel tends to start things on the
+   * low-numbered ones.
+   */
+  cpu_set_t cpus;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) == -1) return -1;
+  
+  for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+    if (CPU_ISSET(cpu, &cpus)) return cpu;
+  }
+  return -1;
+}
+
+DedicatedCPU::DedicatedCPU() : theCPU(dedicatedCPU()) {
+  if (theCPU == -1) return;
+
+  /* If the lock can't be had, the tests still run; they're just not protected from other
+   * processes.
+   */
+  lockFD = open(lockFileFor(theCPU).c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0666);
+  if (lockFD == -1) return;
+
+  while (flock(lockFD, LOCK_EX) == -1) {
+    if (errno != EINTR) {
+      close(lockFD);
+      lockFD = -1;
+      return;
+    }
+  }
+}
+
+DedicatedCPU::~DedicatedCPU() {
+  if (lockFD != -1) close(lockFD);
+}
+
+int DedicatedCPU::cpu() const {
+  return theCPU;
+}
+
+Outcomes runScheduled(vector<ScheduledTest> work, TimingDatabase& timings) {
+  /* Look up how long each test should take just once, rather than on every comparison. */
+  vector<pair<double, ScheduledTest>> plan;
+  plan.reserve(work.size());
+  for (auto& test: work) {
+    double predicted = timings.predict(test.key);
+    plan.emplace_back(predicted, move(test));
+  }
+  
+  /* Longest first. The sort is stable so that tests we know nothing about keep running
+   * in their usual order.
+   */
+  stable_sort(plan.begin(), plan.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.first > rhs.first;
+  });
+  
+  /* Timing-sensitive tests run one at a time before everything else. */
+  auto shared = stable_partition(plan.begin(), plan.end(), [](const auto& entry) {
+    return entry.second.timingSensitive;
+  }) - plan.begin();
+  
+  double exclusiveTime = 0;
+  vector<double> sharedTimes;
+  for (size_t i = 0; i < plan.size(); i++) {
+    if (i < size_t(shared)) exclusiveTime += plan[i].first;
+    else sharedTimes.push_back(plan[i].first);
+    work[i] = move(plan[i].second);
+  }
+  
+  size_t numWorkers = max<size_t>(1, min(testOptions().numJobs, sharedTimes.size()));
+  
+  Outcomes outcomes;
+  mutex outcomesLock;
+  
+  auto runOne = [&](const ScheduledTest& test, int cpu) {
+    ostringstream log;
+    
+    auto start  = chrono::steady_clock::now();
+    auto result = test.test->execute(testOptions().timeoutFor(test.key), log, cpu, test.needsScratch);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    
+    {
+      lock_guard<mutex> lock(outcomesLock);
+      outcomes[test.test.get()] = result;
+      timings.record(test.key, elapsed.count());
+    }
+    if (auto single = dynamic_pointer_cast<SingleTestResult>(result)) {
+      runMetrics().recordTest(single->status(), elapsed.count());
+    }
+    {
+      lock_guard<mutex> lock(driverOutputLock());
+      cout << log.str() << flush;
+    }
+  };
+  
+  auto start = chrono::steady_clock::now();
+  
+  if (shared > 0) {
+    DedicatedCPU dedicated;
+    for (size_t i = 0; i < size_t(shared); i++) {
+      runOne(work[i], dedicated.cpu());
+    }
+  }
+  
+  atomic<size_t> next(shared);
+  auto worker = [&] {
+    for (size_t index; (index = next++) < work.size(); ) {
+      runOne(work[index], -1);
+    }
+  };
+  
+  vector<thread> workers;
+  for (size_t i = 1; i < numWorkers; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread: workers) {
+    thread.join();
+  }
+  
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  
+  if (testOptions().reportSchedule) {
+    cout << fixed << setprecision(3)
+         << "Ran " << work.size() << " tests on " << numWorkers << " worker(s), "
+         << shared << " of them alone. "
+         << "Predicted time: " << exclusiveTime + predictedRunTime(sharedTimes, numWorkers) << "s; "
+         << "actual time: " << elapsed.count() << "s." << endl;
+    cout.unsetf(ios::floatfield);
+  }
+  
+  return outcomes;
+}
@@ -0,0 +1,46 @@
+/* Runs a batch of test cases across several worker threads. Tests are started in order of
+ * how long they're expected to take, longest first, which keeps a few slow tests from
+ * stretching out the end of a run. Timing-sensitive tests are run first, one at a time,
+ * each pinned to a CPU of its own.
+ */
+
+#ifndef TestScheduler_Included
+#define TestScheduler_Included
+
+#include "Test.h"
+#include "TestTimings.h"
+#include <vector>
+#include <mutex>
+
+/* Runs all the given tests, recording how long each took, and returns their results. The
+ * driver log for each test is printed in one piece once that test finishes.
+ */
+Outcomes runScheduled(std::vector<ScheduledTest> work, TimingDatabase& timings);
+
+/* Returns the CPU that timing-sensitive tests are pinned to, or -1 if there isn't one. */
+int dedicatedCPU();
+
+/* Claims the dedicated CPU for as long as it exists. Every run-tests process on the machine
+ * picks the same CPU, and the grading daemon runs several of them side by side, so this
+ * takes a lock that the others also take and waits until it's free.
+ */
+class DedicatedCPU {
+public:
+  DedicatedCPU();
+  ~DedicatedCPU();
+
+  /* The CPU to pin tests to, or -1 if there isn't one. */
+  int cpu() const;
+
+  DedicatedCPU(const DedicatedCPU&) = delete;
+  void operator= (const DedicatedCPU&) = delete;
+
+private:
+  int theCPU;
+  int lockFD = -1;
+};
+
+/* Lock that must be held while writing to cout once tests are running. */
+std::mutex& driverOutputLock();
+
+#endif
@@ -0,0 +1,182 @@
+#include "TestScratch.h"
+#include "TestCommon.h"
+#include "TestOptions.h"
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <filesystem>
+#include <mutex>
+using namespace std;
+
+namespace {
+  /* Where scratch space goes by default. It's RAM-backed, so copying the test data there
+   * is quick; if it isn't available, we fall back on the usual temporary directory.
+   */
+  const char* const kRAMFileSystem = "/dev/shm";
+
+  /* Makes destination a copy of source, as a copy-on-write clone if the file system can
+   * do that, and as a plain copy otherwise. Either way, writing to one never affects the
+   * other.
+   */
+  bool cloneFile(const filesystem::path& source, const filesystem::path& destination) {
+    int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in == -1) return false;
+
+    struct stat info;
+    int out = -1;
+    if (fstat(in, &info) == 0) {
+      out = open(destination.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, (info.st_mode & 07777) | S_IWUSR);
+    }
+    if (out == -1) {
+      close(in);
+      return false;
+    }
+
+    bool cloned = ioctl(out, FICLONE, in) == 0;
+    close(in);
+    close(out);
+    if (cloned) return true;
+
+    /* copy_file copies the permissions too, and the source is read-only. */
+    error_code error;
+    filesystem::copy_file(source, destination, filesystem::copy_options::overwrite_existing, error);
+    if (!error) filesystem::permissions(destination, filesystem::perms::owner_write, filesystem::perm_options::add, error);
+    return !error;
+  }
+
+  /* Total space taken up by the regular files in a directory. */
+  uintmax_t spaceUsedBy(const filesystem::path& directory) {
+    uintmax_t result = 0;
+    error_code error;
+    for (filesystem::recursive_directory_iterator itr(directory, error), end; !error && itr != end; itr.increment(error)) {
+      struct stat info;
+      if (lstat(itr->path().c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+        result += uintmax_t(info.st_blocks) * 512;
+      }
+    }
+    return result;
+  }
+
+  /* Takes away write permission on every file in a directory, leaving the directories
+   * themselves alone so the whole thing can still be removed.
+   */
+  void makeFilesReadOnly(const filesystem::path& directory) {
+    error_code error;
+    for (filesystem::recursive_directory_iterator itr(directory, error), end; !error && itr != end; itr.increment(error)) {
+      if (itr->is_regular_file() && !itr->is_symlink()) {
+        filesystem::permissions(itr->path(), filesystem::perms::owner_write | filesystem::perms::group_write |
+                                             filesystem::perms::others_write,
+                                filesystem::perm_options::remove, error);
+      }
+    }
+  }
+
+  /* The run's copy of the test data, and the scratch directories made from it. */
+  class StagedData {
+  public:
+    StagedData() {
+      error_code error;
+      filesystem::path base = kRAMFileSystem;
+      if (!filesystem::is_directory(base, error) || access(base.c_str(), W_OK) != 0) {
+        base = filesystem::temp_directory_path();
+      }
+      root = base / ("run-tests." + to_string(getpid()));
+      data = root / "data";
+      sharedPath = data.string();
+
+      const auto& source = testOptions().testData;
+      if (!filesystem::is_directory(source, error)) {
+        emergencyAbort("Test data directory " + source + " doesn't exist.");
+      }
+
+      filesystem::remove_all(root, error);
+      filesystem::create_directories(root, error);
+      filesystem::copy(source, data, filesystem::copy_options::recursive |
+                                     filesystem::copy_options::copy_symlinks, error);
+      if (error) emergencyAbort("Couldn't copy test data into " + root.string() + ": " + error.message());
+
+      dataSize = spaceUsedBy(data);
+      makeFilesReadOnly(data);
+    }
+
+    ~StagedData() {
+      error_code error;
+      filesystem::remove_all(root, error);
+    }
+
+    /* Makes a fresh scratch directory holding a copy of all the data. Several of these can
+     * be made at once.
+     */
+    string newScratchDirectory() {
+      filesystem::path directory;
+      {
+        lock_guard<mutex> guard(lock);
+        directory = root / to_string(nextID++);
+      }
+
+      error_code error;
+      filesystem::create_directory(directory, error);
+      if (error) emergencyAbort("Couldn't create scratch directory " + directory.string() + ".");
+
+      for (filesystem::recursive_directory_iterator itr(data, error), end; !error && itr != end; itr.increment(error)) {
+        auto target = directory / filesystem::relative(itr->path(), data);
+        if (itr->is_symlink()) {
+          filesystem::copy_symlink(itr->path(), target, error);
+        } else if (itr->is_directory()) {
+          filesystem::create_directory(target, error);
+        } else if (!cloneFile(itr->path(), target)) {
+          emergencyAbort("Couldn't copy " + itr->path().string() + " into scratch directory " + directory.string() + ".");
+        }
+      }
+      if (error) emergencyAbort("Couldn't fill scratch directory " + directory.string() + ": " + error.message());
+
+      return directory;
+    }
+
+    /* The copy tests without scratch directories share. */
+    const string& sharedDirectory() const {
+      return sharedPath;
+    }
+
+    /* How much more space a scratch directory takes up than the data it started with. */
+    uintmax_t growthOf(const string& directory) const {
+      uintmax_t used = spaceUsedBy(directory);
+      return used > dataSize? used - dataSize : 0;
+    }
+
+  private:
+    filesystem::path root, data;
+    string sharedPath;
+    uintmax_t dataSize = 0;
+    size_t nextID = 0;
+    mutex lock;
+  };
+
+  StagedData& stagedData() {
+    static StagedData theData;
+    return theData;
+  }
+}
+
+ScratchDirectory::ScratchDirectory() : thePath(stagedData().newScratchDirectory()) {
+
+}
+
+ScratchDirectory::~ScratchDirectory() {
+  error_code error;
+  filesystem::remove_all(thePath, error);
+}
+
+const string& ScratchDirectory::path() const {
+  return thePath;
+}
+
+uintmax_t ScratchDirectory::spaceUsed() const {
+  return stagedData().growthOf(thePath);
+}
+
+const string& sharedTestData() {
+  return stagedData().sharedDirectory();
+}
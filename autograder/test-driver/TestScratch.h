@@ -0,0 +1,43 @@
+/* Where tests that read and write files run. When run-tests is given a directory of test
+ * data, it's copied once per run onto a RAM-backed file system where there is one, and
+ * each test's child process runs in that copy. The copy is shared, so its files are made
+ * read-only, though a test running as root can still change them.
+ *
+ * Tests in a group marked with GIVE_TESTS_SCRATCH_SPACE instead each run in a scratch
+ * directory of their own, holding a private copy of the data: a copy-on-write clone where
+ * the file system supports them, and a plain copy otherwise. Those tests can create,
+ * change, and delete files freely, even while other tests are running. On a file system
+ * without clones, such as tmpfs, every such test pays for copying the whole data set, so
+ * only ask for scratch space where tests need it.
+ */
+
+#ifndef TestScratch_Included
+#define TestScratch_Included
+
+#include <string>
+#include <cstdint>
+
+/* A scratch directory, removed along with everything in it when this object is destroyed. */
+class ScratchDirectory {
+public:
+  /* Makes a new scratch directory filled with the test data. */
+  ScratchDirectory();
+  ~ScratchDirectory();
+
+  ScratchDirectory(const ScratchDirectory&) = delete;
+  void operator= (const ScratchDirectory&) = delete;
+
+  /* Where the directory is. */
+  const std::string& path() const;
+
+  /* How much more space the directory takes up now than the test data it started with. */
+  std::uintmax_t spaceUsed() const;
+
+private:
+  std::string thePath;
+};
+
+/* The copy of the test data shared by tests without scratch directories of their own. */
+const std::string& sharedTestData();
+
+#endif
@@ -0,0 +1,177 @@
+#include "TestStackDump.h"
+#include "TestChannel.h"
+#include "TestCommon.h"
+#include <execinfo.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <cxxabi.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <sstream>
+#include <algorithm>
+using namespace std;
+
+const int kStackDumpSignal = SIGUSR2;
+
+namespace {
+  /* Maximum number of frames to report per thread. This keeps each BACKTRACE record small
+   * enough to be written atomically.
+   */
+  const int kMaxFrames = 64;
+
+  /* Where to write stack snapshots. */
+  int dumpFD = -1;
+
+  /* Stack for the signal handler to run on, in case the main thread's stack is exhausted. */
+  const size_t kAltStackSize = 64 * 1024;
+  char altStack[kAltStackSize];
+
+  /* Layout of the records returned by getdents64. glibc doesn't export this type. */
+  struct LinuxDirent64 {
+    ino64_t        d_ino;
+    off64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[1]; // Actually variable-length
+  };
+
+  /* Parses a thread ID from a directory name, returning -1 if it isn't one. Hand-rolled
+   * because strtol isn't async-signal-safe.
+   */
+  pid_t parseTID(const char* name) {
+    if (*name == '\0') return -1;
+
+    pid_t result = 0;
+    for (; *name != '\0'; name++) {
+      if (*name < '0' || *name > '9') return -1;
+      result = result * 10 + (*name - '0');
+    }
+    return result;
+  }
+
+  /* Forwards the stack dump signal to every thread in this process other than the current
+   * one, so that they all report where they are.
+   */
+  void signalOtherThreads() {
+    int dir = open("/proc/self/task", O_RDONLY | O_DIRECTORY);
+    if (dir == -1) return;
+
+    pid_t self = syscall(SYS_gettid);
+    alignas(LinuxDirent64) char buffer[4096];
+    while (true) {
+      long bytes = syscall(SYS_getdents64, dir, buffer, sizeof(buffer));
+      if (bytes <= 0) break;
+
+      for (long offset = 0; offset < bytes; ) {
+        auto* entry = reinterpret_cast<LinuxDirent64*>(buffer + offset);
+        pid_t tid = parseTID(entry->d_name);
+        if (tid != -1 && tid != self) {
+          syscall(SYS_tgkill, getpid(), tid, kStackDumpSignal);
+        }
+        offset += entry->d_reclen;
+      }
+    }
+
+    close(dir);
+  }
+
+  /* Signal handler. Everything in here needs to be async-signal-safe. backtrace() is
+   * safe to call here only because installStackDumpHandler() has already called it
+   * once, forcing it to load everything it needs.
+   */
+  void stackDumpHandler(int, siginfo_t* info, void*) {
+    int savedErrno = errno;
+
+    /* If the driver sent this signal, pass it along to all the other threads. If
+     * another thread did, we're one of those threads and shouldn't forward it again.
+     */
+    if (info->si_code == SI_USER) signalOtherThreads();
+
+    /* Frame zero is this handler, so we skip it. */
+    void* frames[kMaxFrames + 1];
+    int numFrames = backtrace(frames, kMaxFrames + 1) - 1;
+
+    char payload[sizeof(pid_t) + kMaxFrames * sizeof(void*)];
+    pid_t tid = syscall(SYS_gettid);
+    memcpy(payload, &tid, sizeof(tid));
+    if (numFrames > 0) memcpy(payload + sizeof(tid), frames + 1, numFrames * sizeof(void*));
+
+    writeRecord(dumpFD, RecordType::BACKTRACE, payload,
+                sizeof(tid) + max(numFrames, 0) * sizeof(void*));
+
+    errno = savedErrno;
+  }
+
+  /* Given a line from backtrace_symbols, such as
+   *
+   *    ./run-tests(_Z11spinForeverv+0x12) [0x55d0c0a0b1c2]
+   *
+   * demangles the symbol name, if there is one.
+   */
+  string demangle(const string& line) {
+    auto open = line.find('(');
+    auto plus = line.find('+', open);
+    if (open == string::npos || plus == string::npos || plus == open + 1) return line;
+
+    string mangled = line.substr(open + 1, plus - open - 1);
+
+    int status;
+    char* demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+    if (status != 0) return line;
+
+    string result = line.substr(0, open + 1) + demangled + line.substr(plus);
+    free(demangled);
+    return result;
+  }
+}
+
+void installStackDumpHandler(int fd) {
+  dumpFD = fd;
+
+  /* Prime backtrace() so that it doesn't need to allocate when first called in the handler. */
+  void* unused[1];
+  backtrace(unused, 1);
+
+  stack_t stack;
+  stack.ss_sp    = altStack;
+  stack.ss_size  = kAltStackSize;
+  stack.ss_flags = 0;
+  if (sigaltstack(&stack, nullptr) == -1) emergencyAbort("sigaltstack() failed.");
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = stackDumpHandler;
+  action.sa_flags     = SA_SIGINFO | SA_ONSTACK | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(kStackDumpSignal, &action, nullptr) == -1) emergencyAbort("sigaction() failed.");
+}
+
+vector<string> describeBacktrace(const string& payload) {
+  if (payload.size() < sizeof(pid_t)) return { "(malformed stack snapshot)" };
+
+  pid_t tid;
+  memcpy(&tid, payload.data(), sizeof(tid));
+
+  vector<void*> frames((payload.size() - sizeof(tid)) / sizeof(void*));
+  memcpy(frames.data(), payload.data() + sizeof(tid), frames.size() * sizeof(void*));
+
+  vector<string> result = { "Thread " + to_string(tid) + ":" };
+
+  char** symbols = backtrace_symbols(frames.data(), frames.size());
+  if (symbols == nullptr) emergencyAbort("backtrace_symbols() failed.");
+
+  for (size_t i = 0; i < frames.size(); i++) {
+    ostringstream line;
+    line << "  #" << i << " " << demangle(symbols[i]);
+    result.push_back(line.str());
+  }
+
+  free(symbols);
+  return result;
+}
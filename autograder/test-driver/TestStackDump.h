@@ -0,0 +1,26 @@
+/* Functions for taking a snapshot of where a test's child process is stuck. When a test runs
+ * out of time, the driver signals the child, which then reports the stack of each of its
+ * threads back across the result channel before being killed.
+ */
+
+#ifndef TestStackDump_Included
+#define TestStackDump_Included
+
+#include <string>
+#include <vector>
+
+/* Signal the driver sends to a child process to request a stack snapshot. */
+extern const int kStackDumpSignal;
+
+/* Installs a handler in the current (child) process that responds to kStackDumpSignal by
+ * writing a BACKTRACE record for each thread to the given file descriptor.
+ */
+void installStackDumpHandler(int fd);
+
+/* Given the payload of a BACKTRACE record, returns human-readable lines describing it. This
+ * must be called in the driver process that forked the child that sent the record, since it
+ * relies on the two processes sharing an address space layout.
+ */
+std::vector<std::string> describeBacktrace(const std::string& payload);
+
+#endif
@@ -0,0 +1,79 @@
+#include "TestStages.h"
+#include "TestCommon.h"
+#include "TestOptions.h"
+#include "JSON.h"
+#include <fstream>
+#include <map>
+using namespace std;
+
+namespace {
+  /* When the program started, in steady_clock ticks. This is a plain integer so that it's
+   * set before any other static initializer runs, including the ones that register tests.
+   */
+  chrono::steady_clock::rep programStart;
+
+  /* GCC runs constructors with lower priorities first, and before ordinary static
+   * initializers; 101 is the first priority not reserved for the implementation.
+   */
+  __attribute__((constructor(101))) void markProgramStart() {
+    programStart = chrono::steady_clock::now().time_since_epoch().count();
+  }
+
+  double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  }
+}
+
+StageTimings& stageTimings() {
+  static StageTimings theTimings;
+  return theTimings;
+}
+
+void StageTimings::record(const string& stage, double seconds) {
+  for (auto& entry: stages) {
+    if (entry.first == stage) {
+      entry.second += seconds;
+      return;
+    }
+  }
+  stages.emplace_back(stage, seconds);
+}
+
+void StageTimings::recordTestCount(size_t count) {
+  numTests = count;
+}
+
+const vector<pair<string, double>>& StageTimings::allStages() const {
+  return stages;
+}
+
+void StageTimings::save(const string& filename) const {
+  vector<JSON> stageList;
+  for (const auto& entry: stages) {
+    stageList.push_back(JSON::object({
+      { "stage",   entry.first  },
+      { "seconds", entry.second },
+    }));
+  }
+
+  ofstream output(filename);
+  if (!output) emergencyAbort("Could not open file " + filename + " for writing.");
+  output << JSON::object({
+    { "tests",  numTests               },
+    { "jobs",   testOptions().numJobs  },
+    { "stages", stageList              },
+  });
+}
+
+void recordRegistrationTime() {
+  chrono::steady_clock::time_point start{chrono::steady_clock::duration(programStart)};
+  stageTimings().record("registration", secondsSince(start));
+}
+
+TimedStage::TimedStage(const string& stage) : stage(stage), start(chrono::steady_clock::now()) {
+
+}
+
+TimedStage::~TimedStage() {
+  stageTimings().record(stage, secondsSince(start));
+}
@@ -0,0 +1,58 @@
+/* Timings for each stage of a run of the test driver, such as registering tests, running
+ * them, and rendering the results. These are written out by --stage-timings so that changes
+ * to the driver can be compared against a baseline (see the bench directory).
+ */
+
+#ifndef TestStages_Included
+#define TestStages_Included
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <cstddef>
+
+class StageTimings {
+public:
+  /* Records that the named stage took the given number of seconds. A stage that runs more
+   * than once accumulates its time.
+   */
+  void record(const std::string& stage, double seconds);
+
+  /* Records how many test cases ran. */
+  void recordTestCount(std::size_t numTests);
+
+  /* Returns each stage and how long it took, in the order the stages first ran. */
+  const std::vector<std::pair<std::string, double>>& allStages() const;
+
+  /* Writes all stage timings, along with how many tests ran, to the given file as JSON. */
+  void save(const std::string& filename) const;
+
+private:
+  std::vector<std::pair<std::string, double>> stages; // In the order they first ran
+  std::size_t numTests = 0;
+};
+
+/* Returns the timings for this run. */
+StageTimings& stageTimings();
+
+/* Records how long it's been since the program started, which is how long registering all
+ * the tests took. Call this first thing in main().
+ */
+void recordRegistrationTime();
+
+/* Type that times its own lifetime as the named stage. */
+class TimedStage {
+public:
+  explicit TimedStage(const std::string& stage);
+  ~TimedStage();
+
+  TimedStage(const TimedStage&) = delete;
+  void operator= (const TimedStage&) = delete;
+
+private:
+  std::string stage;
+  std::chrono::steady_clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "TestTimings.h"
+#include "TestCommon.h"
+#include "JSON.h"
+#include <fstream>
+using namespace std;
+
+namespace {
+  /* How much weight a new measurement gets relative to the history. Test times are noisy,
+   * so one slow run shouldn't completely change how a test is scheduled.
+   */
+  const double kNewSampleWeight = 0.5;
+
+  /* Guess for how long a test takes when we know nothing at all. */
+  const double kDefaultDuration = 0.1;
+}
+
+void TimingDatabase::load(const string& filename) {
+  ifstream input(filename);
+  if (!input) return;
+
+  JSON data = JSON::parse(input);
+  for (auto key: data) {
+    double& duration = durations[key.asString()];
+    total -= duration;
+    duration = data[key].asDouble();
+    total += duration;
+  }
+}
+
+void TimingDatabase::save(const string& filename) const {
+  map<string, JSON> data;
+  for (const auto& entry: durations) {
+    data.insert(make_pair(entry.first, entry.second));
+  }
+
+  ofstream output(filename);
+  if (!output) emergencyAbort("Could not open file " + filename + " for writing.");
+  output << JSON(data);
+}
+
+double TimingDatabase::predict(const string& key) const {
+  auto itr = durations.find(key);
+  if (itr != durations.end()) return itr->second;
+
+  if (durations.empty()) return kDefaultDuration;
+  return total / durations.size();
+}
+
+void TimingDatabase::record(const string& key, double seconds) {
+  auto itr = durations.find(key);
+  if (itr == durations.end()) {
+    durations[key] = seconds;
+    total += seconds;
+  } else {
+    double updated = kNewSampleWeight * seconds + (1 - kNewSampleWeight) * itr->second;
+    total += updated - itr->second;
+    itr->second = updated;
+  }
+}
@@ -0,0 +1,34 @@
+/* A record of how long each test took in previous runs. The scheduler uses this to start
+ * the slowest tests first, so that they don't hold up the end of a run.
+ */
+
+#ifndef TestTimings_Included
+#define TestTimings_Included
+
+#include <string>
+#include <map>
+
+class TimingDatabase {
+public:
+  /* Loads durations from the given file. A missing file is treated as empty. */
+  void load(const std::string& filename);
+
+  /* Writes all durations to the given file. */
+  void save(const std::string& filename) const;
+
+  /* Returns how many seconds we expect the given test to take. Tests we haven't seen
+   * before are assumed to take as long as an average test.
+   */
+  double predict(const std::string& key) const;
+
+  /* Records that the given test took the given number of seconds. */
+  void record(const std::string& key, double seconds);
+
+private:
+  std::map<std::string, double> durations;
+  
+  /* Sum of all the durations, kept up to date so the average is cheap to find. */
+  double total = 0;
+};
+
+#endif
@@ -0,0 +1,184 @@
+/* grade
+ *
+ * Runs the autograder pipeline: copies the student's submission into place, builds it
+ * along with the tests, and runs those tests, writing the results where GradeScope expects
+ * to find them. Run this from the root of the autograder.
+ *
+ * Usage: grade                   Grade the submission in submission/.
+ *        grade --assemble-only   Build everything, but don't run the tests.
+ *        grade --setup           One-time setup when the autograder is installed.
+ *        grade --clean           Remove everything built by setup or a dry run.
+ *        grade --test-manifest   Describe every test in test-manifest.json, building only
+ *                                the tests and not any student code.
+ *        grade --count-points    Print how many points the tests in test-manifest.json
+ *                                are worth.
+ *        grade --watch           Grade, then regrade whenever the tests, starter code, or
+ *                                submission change, rebuilding only what's needed.
+ *        grade --reuse-results   Grade, but only run the tests that depend on something
+ *                                that changed since the last --reuse-results run, reusing
+ *                                the results of the rest.
+ *        grade --serve           Run as a daemon that grades submissions sent to it over a
+ *                                Unix domain socket, --workers N at a time (default 2).
+ *        grade --submit DIR      Send the submission in DIR to the daemon and print where
+ *                                its results went.
+ *
+ * Add --jobs N to run N tests at once, and --socket PATH to pick the daemon's socket.
+ */
+#include "Pipeline.h"
+#include "ToolCommon.h"
+#include "Watcher.h"
+#include "GradingServer.h"
+#include "JSON.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+#include <vector>
+using namespace std;
+
+namespace {
+  /* Where --reuse-results and --watch keep what they need to know about the last run. */
+  const string kImpactMap     = ".autograder.impact.json";
+  const string kSavedOutcomes = ".autograder.outcomes.json";
+
+  /* Program mode: total up the points in the test manifest. */
+  bool countPoints(const PipelineConfig& config) {
+    ifstream input(config.testManifest);
+    if (!input) {
+      cerr << "Cannot open " << config.testManifest << "; run grade --test-manifest first." << endl;
+      return false;
+    }
+
+    cout << static_cast<size_t>(JSON::parse(input)["points"].asDouble()) << endl;
+    return true;
+  }
+
+  /* Program mode: grade, then keep regrading as files change. Never returns. */
+  [[ noreturn ]] void watchForChanges(Pipeline& pipeline, const PipelineConfig& config,
+                                      const GradingJob& job) {
+    Watcher watcher({ config.testsDirectory, config.buildDirectory, job.submissionDirectory });
+
+    bool assembled = pipeline.assemble(job);
+    if (assembled) pipeline.runTests(job);
+
+    while (true) {
+      cout << endl << "Watching for changes..." << endl;
+      auto changed = watcher.waitForChanges();
+      for (const auto& path: changed) {
+        cout << "  Changed: " << path << endl;
+      }
+
+      /* If the last full assembly didn't work, there's nothing to update. */
+      if (!assembled) {
+        assembled = pipeline.assemble(job);
+        if (assembled) pipeline.runTests(job);
+        continue;
+      }
+
+      Rerun rerun;
+      if (!pipeline.update(job, changed, rerun)) continue;
+
+      vector<string> flags;
+      if (!rerun.everything) {
+        for (const auto& file: rerun.testFiles) {
+          flags.insert(flags.end(), { "--from-file", file });
+        }
+      }
+      pipeline.runTests(job, flags);
+    }
+  }
+}
+
+int main(int argc, const char* argv[]) try {
+  bool assembleOnly = false;
+  bool setUp = false;
+  bool clean = false;
+  bool listTests = false;
+  bool countTotal = false;
+  bool watch = false;
+  bool reuseResults = false;
+  bool serve = false;
+  const char* sanitizeDirectory = nullptr;
+  const char* submitDirectory = nullptr;
+  string socketPath = kDefaultSocket;
+  size_t numWorkers = 2;
+  PipelineConfig config;
+
+  for (int i = 1; i < argc; i++) {
+    if (string(argv[i]) == "--assemble-only") {
+      assembleOnly = true;
+    } else if (string(argv[i]) == "--setup") {
+      setUp = true;
+    } else if (string(argv[i]) == "--clean") {
+      clean = true;
+    } else if (string(argv[i]) == "--test-manifest") {
+      listTests = true;
+    } else if (string(argv[i]) == "--count-points") {
+      countTotal = true;
+    } else if (string(argv[i]) == "--watch") {
+      watch = true;
+    } else if (string(argv[i]) == "--reuse-results") {
+      reuseResults = true;
+    } else if (string(argv[i]) == "--serve") {
+      serve = true;
+    } else if (string(argv[i]) == "--build-sanitized") { // Used internally by grade()
+      if (i + 1 == argc) throw invalid_argument("--build-sanitized flag with no argument.");
+      i++;
+      sanitizeDirectory = argv[i];
+    } else if (string(argv[i]) == "--submit") {
+      if (i + 1 == argc) throw invalid_argument("--submit flag with no argument.");
+      i++;
+      submitDirectory = argv[i];
+    } else if (string(argv[i]) == "--socket") {
+      if (i + 1 == argc) throw invalid_argument("--socket flag with no argument.");
+      i++;
+      socketPath = argv[i];
+    } else if (string(argv[i]) == "--workers") {
+      if (i + 1 == argc) throw invalid_argument("--workers flag with no argument.");
+      i++;
+      numWorkers = stoul(argv[i]);
+      if (numWorkers == 0) throw invalid_argument("Need at least one worker.");
+    } else if (string(argv[i]) == "--jobs") {
+      if (i + 1 == argc) throw invalid_argument("--jobs flag with no argument.");
+      i++;
+      config.testJobs = stoul(argv[i]);
+    } else {
+      throw invalid_argument("Unknown command-line option: " + string(argv[i]));
+    }
+  }
+
+  /* Submitting doesn't need the pipeline at all, just the daemon. */
+  if (submitDirectory) {
+    string reply;
+    bool graded = submitJob(socketPath, submitDirectory, reply);
+    cout << reply << endl;
+    return graded? 0 : 1;
+  }
+
+  if (countTotal) return countPoints(config)? 0 : 1;
+
+  Pipeline pipeline(config);
+  GradingJob job;
+  if (reuseResults || watch) {
+    job.impactMap     = kImpactMap;
+    job.savedOutcomes = kSavedOutcomes;
+  }
+
+  if (clean) {
+    pipeline.clean();
+    return 0;
+  }
+  if (listTests) return pipeline.listTests()? 0 : 1;
+  if (sanitizeDirectory) {
+    job.assemblyDirectory = sanitizeDirectory;
+    return pipeline.buildSanitized(job)? 0 : 1;
+  }
+  if (watch)        watchForChanges(pipeline, config, job);
+  if (serve)        serveJobs(pipeline, config, socketPath, numWorkers);
+  if (setUp)        return pipeline.setUp()? 0 : 1;
+  if (assembleOnly) return pipeline.assemble(job)? 0 : 1;
+  return pipeline.grade(job)? 0 : 1;
+} catch (const exception& e) {
+  reportError(string("Internal error: ") + e.what() + " Please contact the course staff.");
+  return 1;
+}
@@ -0,0 +1,337 @@
+#include "GradingServer.h"
+#include "ToolCommon.h"
+#include "JSON.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <signal.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+using namespace std;
+
+const string kDefaultSocket = ".autograder.socket";
+
+namespace {
+  /* Where each job gets its own directory. */
+  const string kJobsDirectory = ".autograder.jobs";
+
+  /* How many job directories to keep around, so that clients have time to read their
+   * results. Older ones are removed as new jobs finish.
+   */
+  const size_t kJobsToKeep = 100;
+
+  /* How long to wait before accepting again when we're out of file descriptors or memory. */
+  const chrono::milliseconds kAcceptRetryDelay(100);
+
+  /* Longest request or reply we'll read. */
+  const size_t kMaxLineLength = 4096;
+
+  /* Fills in a socket address for the given path. */
+  sockaddr_un addressFor(const string& socketPath) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+      throw invalid_argument("Socket path is too long: " + socketPath);
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+    return address;
+  }
+
+  /* Reads one line from a socket, without the newline. Returns false if the other side
+   * hung up first or the line is too long.
+   */
+  bool readLine(int fd, string& line) {
+    line.clear();
+    while (line.size() < kMaxLineLength) {
+      char ch;
+      auto bytes = recv(fd, &ch, 1, 0);
+      if (bytes == -1 && errno == EINTR) continue;
+      if (bytes <= 0) return false;
+
+      if (ch == '\n') return true;
+      line += ch;
+    }
+    return false;
+  }
+
+  /* Writes a line to a socket. A client that hung up doesn't take the server with it. */
+  void writeLine(int fd, const string& line) {
+    string data = line + "\n";
+    for (size_t written = 0; written < data.size(); ) {
+      auto bytes = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+      if (bytes == -1 && errno == EINTR) continue;
+      if (bytes <= 0) return;
+      written += bytes;
+    }
+  }
+
+  /* Connections waiting for a worker. */
+  class ConnectionQueue {
+  public:
+    void push(int fd) {
+      {
+        lock_guard<mutex> lock(queueLock);
+        connections.push_back(fd);
+      }
+      ready.notify_one();
+    }
+
+    int pop() {
+      unique_lock<mutex> lock(queueLock);
+      ready.wait(lock, [&] { return !connections.empty(); });
+
+      int fd = connections.front();
+      connections.pop_front();
+      return fd;
+    }
+
+  private:
+    mutex queueLock;
+    condition_variable ready;
+    deque<int> connections;
+  };
+
+  /* Timings as they're stored in a timing database. */
+  using Timings = map<string, double>;
+
+  /* Reads a timing database. A missing file is treated as empty. */
+  Timings loadTimings(const string& filename) {
+    Timings result;
+    ifstream input(filename);
+    if (!input) return result;
+
+    JSON data = JSON::parse(input);
+    for (auto key: data) {
+      result[key.asString()] = data[key].asDouble();
+    }
+    return result;
+  }
+
+  /* Writes a timing database. It's written alongside and renamed into place, so a run
+   * reading it at the same time never sees half of it.
+   */
+  void saveTimings(const Timings& timings, const string& filename) {
+    map<string, JSON> data;
+    for (const auto& entry: timings) {
+      data.insert(make_pair(entry.first, entry.second));
+    }
+
+    string temp = filename + ".new";
+    {
+      ofstream output(temp);
+      if (!output) return;
+      output << JSON(data);
+    }
+    error_code error;
+    filesystem::rename(temp, filename, error);
+  }
+
+  /* Keeps jobs from reading and updating the shared timing database at the same time. */
+  mutex timingsLock;
+
+  /* Gives a job its own copy of the shared timing database, returning what the copy started
+   * out as.
+   */
+  Timings checkOutTimings(const string& shared, const string& copy) {
+    lock_guard<mutex> lock(timingsLock);
+    auto timings = loadTimings(shared);
+    saveTimings(timings, copy);
+    return timings;
+  }
+
+  /* Folds a job's timings back into the shared database. Only the tests the job actually
+   * ran are taken from it, so timings other jobs recorded in the meantime aren't undone by
+   * this job's stale copy of them.
+   */
+  void checkInTimings(const Timings& original, const string& copy, const string& shared) {
+    lock_guard<mutex> lock(timingsLock);
+    auto timings = loadTimings(shared);
+    for (const auto& entry: loadTimings(copy)) {
+      auto itr = original.find(entry.first);
+      if (itr == original.end() || itr->second != entry.second) {
+        timings[entry.first] = entry.second;
+      }
+    }
+    saveTimings(timings, shared);
+  }
+
+  /* Directories of jobs still being graded, which mustn't be cleaned up. */
+  mutex jobsLock;
+  set<string> activeJobs;
+
+  /* Removes the directories of all but the most recent kJobsToKeep finished jobs. */
+  void removeOldJobs() {
+    lock_guard<mutex> lock(jobsLock);
+
+    vector<pair<filesystem::file_time_type, filesystem::path>> finished;
+    error_code error;
+    for (const auto& entry: filesystem::directory_iterator(kJobsDirectory, error)) {
+      if (activeJobs.count(entry.path().string())) continue;
+
+      auto modified = entry.last_write_time(error);
+      if (!error) finished.emplace_back(modified, entry.path());
+    }
+    if (finished.size() <= kJobsToKeep) return;
+
+    sort(finished.begin(), finished.end(), greater<>());
+    for (size_t i = kJobsToKeep; i < finished.size(); i++) {
+      filesystem::remove_all(finished[i].second, error);
+    }
+  }
+
+  /* Makes a directory for a new job. Names are picked by mkdtemp, so they're never reused,
+   * not even by a later daemon, and a client's results can't be overwritten by another
+   * job before it reads them.
+   */
+  bool makeJobDirectory(string& directory, string& problem) {
+    error_code error;
+    filesystem::create_directories(kJobsDirectory, error);
+
+    string name = kJobsDirectory + "/job-XXXXXX";
+    if (error || mkdtemp(name.data()) == nullptr) {
+      problem = "Couldn't create a directory in " + kJobsDirectory + ": " +
+                (error? error.message() : strerror(errno));
+      return false;
+    }
+    directory = name;
+
+    lock_guard<mutex> lock(jobsLock);
+    activeJobs.insert(directory);
+    return true;
+  }
+
+  /* Grades one submission, returning the reply to send. */
+  string gradeSubmission(Pipeline& pipeline, const PipelineConfig& config, const string& submission) {
+    if (!filesystem::path(submission).is_absolute() || !filesystem::is_directory(submission)) {
+      return "error Not an absolute path to a directory: " + submission;
+    }
+
+    string directory, problem;
+    if (!makeJobDirectory(directory, problem)) return "error " + problem;
+
+    GradingJob job;
+    job.submissionDirectory = submission;
+    job.assemblyDirectory   = directory + "/assembly";
+    job.resultsFile         = directory + "/results.json";
+    job.missingList         = directory + "/missing.files";
+    job.metricsFile         = directory + "/metrics.prom";
+
+    /* Jobs running side by side can't all update the shared timing database, so each
+     * works from a copy of it and merges what it learned back in afterwards.
+     */
+    job.timingDatabase      = directory + "/test-timings.json";
+
+    auto timings = checkOutTimings(config.timingDatabase, job.timingDatabase);
+    bool graded = pipeline.grade(job);
+    checkInTimings(timings, job.timingDatabase, config.timingDatabase);
+
+    /* The results are all that's needed from here on. */
+    error_code error;
+    filesystem::remove_all(job.assemblyDirectory, error);
+    filesystem::remove_all(filesystem::path(pipeline.sanitizedRunner(job)).parent_path(), error);
+    filesystem::remove(job.timingDatabase, error);
+
+    {
+      lock_guard<mutex> lock(jobsLock);
+      activeJobs.erase(directory);
+    }
+    removeOldJobs();
+
+    return (graded? "done " : "failed ") + filesystem::absolute(job.resultsFile).string();
+  }
+}
+
+void serveJobs(Pipeline& pipeline, const PipelineConfig& config,
+               const string& socketPath, size_t numWorkers) {
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener == -1) throw runtime_error("Couldn't create socket: " + string(strerror(errno)));
+
+  /* A socket left over from an earlier daemon would keep us from binding. */
+  unlink(socketPath.c_str());
+
+  auto address = addressFor(socketPath);
+  if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 ||
+      listen(listener, SOMAXCONN) == -1) {
+    throw runtime_error("Couldn't listen on " + socketPath + ": " + strerror(errno));
+  }
+
+  /* Builds the starter code and test objects that every job starts from. */
+  if (!pipeline.setUp()) throw runtime_error("Setup failed; see the log above.");
+
+  /* The workers are detached, so they share the queue rather than pointing into our frame. */
+  auto queue = make_shared<ConnectionQueue>();
+  for (size_t i = 0; i < numWorkers; i++) {
+    thread([queue, &pipeline, &config] {
+      while (true) {
+        int client = queue->pop();
+
+        string submission;
+        if (readLine(client, submission)) {
+          writeLine(client, gradeSubmission(pipeline, config, submission));
+        }
+        close(client);
+      }
+    }).detach();
+  }
+
+  cout << "Grading submissions sent to " << socketPath << " with "
+       << numWorkers << " worker" << (numWorkers == 1? "" : "s") << "." << endl;
+
+  while (true) {
+    int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+
+      /* Running short on resources passes once some jobs finish, so it isn't worth dying
+       * over, and dying would pull the pipeline out from under the workers.
+       */
+      if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+        this_thread::sleep_for(kAcceptRetryDelay);
+        continue;
+      }
+      throw runtime_error("Couldn't accept connection: " + string(strerror(errno)));
+    }
+    queue->push(client);
+  }
+}
+
+bool submitJob(const string& socketPath, const string& submissionDirectory, string& reply) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    reply = "Couldn't create socket: " + string(strerror(errno));
+    return false;
+  }
+
+  auto address = addressFor(socketPath);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+    reply = "Couldn't connect to " + socketPath + ": " + strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  writeLine(fd, filesystem::absolute(submissionDirectory).lexically_normal().string());
+  bool answered = readLine(fd, reply);
+  close(fd);
+
+  if (!answered) {
+    reply = "The grading daemon hung up without answering.";
+    return false;
+  }
+  return reply.compare(0, 5, "done ") == 0;
+}
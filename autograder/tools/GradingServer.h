@@ -0,0 +1,37 @@
+/* A long-running grading daemon. It keeps the pipeline, its configuration, and a pool of
+ * worker threads around between submissions, and accepts jobs over a Unix domain socket,
+ * so that each submission skips the autograder's startup costs.
+ *
+ * The protocol is one line each way. A client connects and sends the absolute path of a
+ * submission directory. The server grades it and answers with "done" or "failed" followed
+ * by the absolute path of the results file, or with "error" and a message if the job
+ * couldn't be graded at all.
+ */
+
+#ifndef GradingServer_Included
+#define GradingServer_Included
+
+#include "Pipeline.h"
+#include <string>
+#include <cstddef>
+
+/* Where the daemon listens unless told otherwise. */
+extern const std::string kDefaultSocket;
+
+/* Listens on the given socket and grades submissions sent to it, numWorkers at a time.
+ * Each job is assembled in a directory of its own with a name no other job, from this
+ * daemon or an earlier one, has used; only the most recent of those are kept. What each
+ * job learns about how long tests take is merged back into the shared timing database.
+ * Never returns.
+ */
+[[ noreturn ]] void serveJobs(Pipeline& pipeline, const PipelineConfig& config,
+                              const std::string& socketPath, std::size_t numWorkers);
+
+/* Sends a submission directory to the daemon listening on the given socket and waits for
+ * the reply, returning whether the submission was graded. The daemon's reply is stored in
+ * reply, or an error message if it couldn't be reached.
+ */
+bool submitJob(const std::string& socketPath, const std::string& submissionDirectory,
+               std::string& reply);
+
+#endif
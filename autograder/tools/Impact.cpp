@@ -0,0 +1,287 @@
+#include "Impact.h"
+#include "ToolCommon.h"
+#include "JSON.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <queue>
+#include <set>
+using namespace std;
+
+namespace {
+  /* FNV-1a, which is plenty for telling whether a file changed. */
+  const uint64_t kFNVOffset = 0xcbf29ce484222325ull;
+  const uint64_t kFNVPrime  = 0x100000001b3ull;
+
+  uint64_t fingerprint(const string& data, uint64_t hash = kFNVOffset) {
+    for (unsigned char ch: data) {
+      hash = (hash ^ ch) * kFNVPrime;
+    }
+    return hash;
+  }
+
+  /* Fingerprints are written in hex, since JSON numbers can't hold all 64 bits. */
+  string toHex(uint64_t value) {
+    ostringstream result;
+    result << hex << value;
+    return result.str();
+  }
+
+  uint64_t fromHex(const string& text) {
+    return stoull(text, nullptr, 16);
+  }
+
+  /* Static initializers run in every process the object is linked into. */
+  const string kStaticInitializerPrefix = "_GLOBAL__sub_I_";
+
+  /* The symbols an object file defines and refers to. */
+  struct Symbols {
+    set<string> strong;     // Defined, and not overridable
+    set<string> weak;       // Defined, but another definition might be used instead
+    set<string> undefined;  // Referred to, but defined somewhere else
+    bool hasStaticInitializers = false;
+  };
+
+  /* Reads an object's symbol table with nm. If that fails, the object looks like it has
+   * static initializers, which makes every test depend on it.
+   */
+  Symbols symbolsIn(const string& object) {
+    Symbols result;
+
+    string listing;
+    if (!captureCommand({ "nm", "-P", object }, ".", listing)) {
+      result.hasStaticInitializers = true;
+      return result;
+    }
+
+    istringstream lines(listing);
+    for (string name, type, rest; lines >> name >> type && getline(lines, rest); ) {
+      if (name.compare(0, kStaticInitializerPrefix.size(), kStaticInitializerPrefix) == 0) {
+        result.hasStaticInitializers = true;
+      }
+
+      /* See the nm documentation for what each type letter means. */
+      if (type == "U" || type == "w" || type == "v") {
+        result.undefined.insert(name);
+      } else if (type == "W" || type == "V" || type == "u" || type == "C") {
+        result.weak.insert(name);
+      } else if (isupper(type[0])) {
+        result.strong.insert(name);
+      }
+    }
+    return result;
+  }
+
+  /* Objects linked into a program, and which others each one could call into. */
+  class ObjectGraph {
+  public:
+    ObjectGraph(const map<string, Symbols>& objects) {
+      /* A strong definition wins at link time; failing that, any of the weak ones might. */
+      map<string, set<string>> strongDefiners, weakDefiners;
+      for (const auto& object: objects) {
+        for (const auto& symbol: object.second.strong) strongDefiners[symbol].insert(object.first);
+        for (const auto& symbol: object.second.weak)   weakDefiners[symbol].insert(object.first);
+      }
+
+      for (const auto& object: objects) {
+        auto& targets = edges[object.first];
+        for (const auto& symbol: object.second.undefined) {
+          auto definers = strongDefiners.find(symbol);
+          if (definers == strongDefiners.end()) {
+            definers = weakDefiners.find(symbol);
+            if (definers == weakDefiners.end()) continue;
+          }
+          targets.insert(definers->second.begin(), definers->second.end());
+        }
+      }
+    }
+
+    /* Every object reachable from the given ones, including them. */
+    set<string> reachableFrom(const set<string>& roots) const {
+      set<string> result = roots;
+      queue<string> worklist;
+      for (const auto& root: roots) {
+        worklist.push(root);
+      }
+
+      while (!worklist.empty()) {
+        auto curr = worklist.front();
+        worklist.pop();
+
+        auto targets = edges.find(curr);
+        if (targets == edges.end()) continue;
+        for (const auto& next: targets->second) {
+          if (result.insert(next).second) worklist.push(next);
+        }
+      }
+      return result;
+    }
+
+  private:
+    map<string, set<string>> edges;
+  };
+}
+
+ImpactMap mapImpact(const string& directory,
+                    const vector<string>& testFiles,
+                    const vector<string>& studentObjects,
+                    const vector<string>& sharedFiles,
+                    const vector<string>& dataFiles) {
+  ImpactMap result;
+
+  result.shared = kFNVOffset;
+  for (const auto& file: sharedFiles) {
+    result.shared = fingerprint(file + '\0' + (filesystem::exists(file)? "+" + contentsOf(file) : "-") + '\0',
+                                result.shared);
+  }
+
+  /* Test data can be large, so reading all of it would cost more than it could save. */
+  for (const auto& file: dataFiles) {
+    error_code sizeError, timeError;
+    auto size = filesystem::file_size(file, sizeError);
+    auto time = filesystem::last_write_time(file, timeError);
+    string stamp = (sizeError || timeError)? "-" : to_string(size) + "@" + to_string(time.time_since_epoch().count());
+    result.shared = fingerprint(file + '\0' + stamp + '\0', result.shared);
+  }
+
+  /* Every object in the directory gets linked into run-tests. Running nm on each of them
+   * is most of the work here, so those run side by side, one per CPU.
+   */
+  vector<string> names;
+  error_code error;
+  for (filesystem::recursive_directory_iterator itr(directory, error), end; !error && itr != end; itr.increment(error)) {
+    if (itr->path().extension() == ".o") {
+      names.push_back(filesystem::relative(itr->path(), directory).string());
+    }
+  }
+
+  vector<Symbols>  listings(names.size());
+  vector<uint64_t> hashes(names.size());
+  atomic<size_t> next(0);
+  auto worker = [&] {
+    for (size_t index; (index = next++) < names.size(); ) {
+      string path = directory + "/" + names[index];
+      listings[index] = symbolsIn(path);
+      hashes[index]   = fingerprint(contentsOf(path));
+    }
+  };
+
+  size_t numWorkers = max<size_t>(1, min<size_t>(thread::hardware_concurrency(), names.size()));
+  vector<thread> workers;
+  for (size_t i = 1; i < numWorkers; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread: workers) {
+    thread.join();
+  }
+
+  map<string, Symbols> objects;
+  map<string, uint64_t> fingerprints;
+  for (size_t i = 0; i < names.size(); i++) {
+    objects[names[i]]      = move(listings[i]);
+    fingerprints[names[i]] = hashes[i];
+  }
+
+  set<string> testObjects;
+  for (const auto& file: testFiles) {
+    testObjects.insert(filesystem::path(file).replace_extension(".o").string());
+  }
+  set<string> ownedByStudent(studentObjects.begin(), studentObjects.end());
+
+  /* Whatever isn't a test is part of every test if it belongs to the driver, or if it's the
+   * student's and has code that runs before any test does.
+   */
+  set<string> everywhere;
+  for (const auto& object: objects) {
+    if (testObjects.count(object.first)) continue;
+    if (!ownedByStudent.count(object.first) || object.second.hasStaticInitializers) {
+      everywhere.insert(object.first);
+    }
+  }
+
+  ObjectGraph graph(objects);
+  for (const auto& file: testFiles) {
+    auto roots = everywhere;
+    roots.insert(filesystem::path(file).replace_extension(".o").string());
+
+    auto& dependencies = result.tests[file];
+    for (const auto& object: graph.reachableFrom(roots)) {
+      auto itr = fingerprints.find(object);
+      dependencies[object] = (itr == fingerprints.end()? 0 : itr->second);
+    }
+  }
+  return result;
+}
+
+map<string, string> affectedTests(const ImpactMap& before, const ImpactMap& after, bool& everything) {
+  everything = before.tests.empty() || before.shared != after.shared;
+  if (everything) return {};
+
+  map<string, string> result;
+  for (const auto& test: after.tests) {
+    auto previous = before.tests.find(test.first);
+    if (previous == before.tests.end()) {
+      result[test.first] = "new test file";
+      continue;
+    }
+
+    string changed;
+    for (const auto& dependency: test.second) {
+      auto old = previous->second.find(dependency.first);
+      if (old == previous->second.end() || old->second != dependency.second) {
+        changed += (changed.empty()? "" : ", ") + dependency.first;
+      }
+    }
+    for (const auto& dependency: previous->second) {
+      if (!test.second.count(dependency.first)) {
+        changed += (changed.empty()? "" : ", ") + dependency.first;
+      }
+    }
+    if (!changed.empty()) result[test.first] = "changed " + changed;
+  }
+  return result;
+}
+
+void saveImpactMap(const string& filename, const ImpactMap& impact) {
+  map<string, JSON> tests;
+  for (const auto& test: impact.tests) {
+    map<string, JSON> dependencies;
+    for (const auto& dependency: test.second) {
+      dependencies.insert(make_pair(dependency.first, toHex(dependency.second)));
+    }
+    tests.insert(make_pair(test.first, JSON(dependencies)));
+  }
+
+  ofstream output(filename);
+  output << JSON::object({
+    { "shared", toHex(impact.shared) },
+    { "tests",  JSON(tests)          }
+  });
+}
+
+ImpactMap loadImpactMap(const string& filename) {
+  ifstream input(filename);
+  if (!input) return {};
+
+  /* A map we can't read is the same as no map at all: everything runs. */
+  try {
+    ImpactMap result;
+    JSON data = JSON::parse(input);
+    result.shared = fromHex(data["shared"].asString());
+
+    JSON tests = data["tests"];
+    for (auto test: tests) {
+      auto& dependencies = result.tests[test.asString()];
+      for (auto dependency: tests[test]) {
+        dependencies[dependency.asString()] = fromHex(tests[test][dependency].asString());
+      }
+    }
+    return result;
+  } catch (const exception &) {
+    return {};
+  }
+}
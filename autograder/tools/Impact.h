@@ -0,0 +1,59 @@
+/* Test impact analysis: working out which test files could behave differently after a change,
+ * so that a regrade only has to run those and can reuse the last run's results for the rest.
+ *
+ * Everything is worked out from the object files in an assembled directory. Each test file's
+ * object refers to symbols defined in other objects, which in turn refer to others, and every
+ * object reachable that way is one the test file depends on. A test file needs to run again
+ * if any object it depends on now has different contents. Since the objects are what actually
+ * gets linked, this sees through comment-only edits and catches changes that the source
+ * files alone wouldn't show.
+ *
+ * The analysis is deliberately conservative. The test driver, and any student object with
+ * static initializers, runs in every test, so they count as dependencies of every test file.
+ * Headers can change code that's inlined anywhere, so any change to one reruns everything.
+ */
+
+#ifndef Impact_Included
+#define Impact_Included
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+/* What every test file in an assembled directory depends on. */
+struct ImpactMap {
+  /* Fingerprint of everything that could change how every test behaves at once. */
+  std::uint64_t shared = 0;
+
+  /* For each test file, relative to the tests directory, a fingerprint of each object it
+   * depends on, including its own.
+   */
+  std::map<std::string, std::map<std::string, std::uint64_t>> tests;
+};
+
+/* Maps out the objects in an assembled directory. Test files and student objects are given
+ * relative to that directory; every other object in it is assumed to belong to the driver.
+ * The contents of the shared files, and whether they exist, go into the shared fingerprint.
+ * So do the data files, but only by size and modification time, since they can be large.
+ */
+ImpactMap mapImpact(const std::string& directory,
+                    const std::vector<std::string>& testFiles,
+                    const std::vector<std::string>& studentObjects,
+                    const std::vector<std::string>& sharedFiles,
+                    const std::vector<std::string>& dataFiles);
+
+/* Returns which test files need to run again, going from the before map to the after map,
+ * or sets everything if they all do. Each test file that needs to run again comes with
+ * why, for the log.
+ */
+std::map<std::string, std::string> affectedTests(const ImpactMap& before, const ImpactMap& after,
+                                                 bool& everything);
+
+/* Saves and loads impact maps. Loading a file that doesn't exist or can't be read gives an
+ * empty map, which everything is affected by.
+ */
+void saveImpactMap(const std::string& filename, const ImpactMap& map);
+ImpactMap loadImpactMap(const std::string& filename);
+
+#endif
@@ -0,0 +1,633 @@
+#include "Pipeline.h"
+#include "SubmissionIndex.h"
+#include "ToolCommon.h"
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <algorithm>
+using namespace std;
+
+namespace {
+  /* Guards the console, since stages can finish on different threads. */
+  mutex consoleLock;
+
+  /* Name of the file make's stderr is captured into. */
+  const string kErrorLog = ".autograder.error.log";
+
+  /* Returns whether the file name looks like a C++ source file. */
+  bool isSourceFile(const filesystem::path& path) {
+    auto extension = path.extension().string();
+    return extension == ".cpp" || extension == ".cc" || extension == ".cxx";
+  }
+
+  /* Where the sanitized build goes, relative to the assembly directory. */
+  const string kSanitizedSuffix = ".sanitized";
+
+  /* Flags added to every compile and link in the sanitized build. */
+  const string kSanitizerFlags = "-fsanitize=address,undefined -fno-omit-frame-pointer -g";
+
+  /* Returns the full path of a program found in the PATH, or the empty string if there
+   * isn't one.
+   */
+  string findProgram(const string& name) {
+    const char* path = getenv("PATH");
+    istringstream directories(path? path : "");
+    for (string directory; getline(directories, directory, ':'); ) {
+      auto candidate = filesystem::path(directory.empty()? "." : directory) / name;
+      if (access(candidate.c_str(), X_OK) == 0) return filesystem::absolute(candidate).string();
+    }
+    return "";
+  }
+
+  /* Names of the stages that compile and link, which metrics single out. */
+  const string kCompileSubmission = "build submission";
+  const string kCompileTests      = "compile tests";
+  const string kLinkTests         = "link tests";
+
+  /* Where run-tests writes its metrics, relative to the assembly directory. */
+  const string kTestMetrics = ".autograder.metrics.prom";
+
+  /* Makes this process, and everything it starts from now on, run only when nothing else
+   * wants a CPU. It also stays off the CPU that run-tests pins timing-sensitive tests to,
+   * which is the highest-numbered one (see dedicatedCPU() in the test driver), as long as
+   * that leaves it somewhere to run.
+   */
+  void yieldToTests() {
+    sched_param param{};
+    sched_setscheduler(0, SCHED_IDLE, &param);
+    setpriority(PRIO_PROCESS, 0, 19);
+
+    cpu_set_t cpus;
+    if (sched_getaffinity(0, sizeof(cpus), &cpus) == -1 || CPU_COUNT(&cpus) < 2) return;
+    for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+      if (CPU_ISSET(cpu, &cpus)) {
+        CPU_CLR(cpu, &cpus);
+        break;
+      }
+    }
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+  }
+
+  /* Returns the absolute version of a path, since some stages run in other directories. */
+  string absolute(const string& path) {
+    return filesystem::absolute(path).string();
+  }
+}
+
+Pipeline::Pipeline(const PipelineConfig& config) : config(config), manifest(readManifest(config.manifestFile)) {
+
+}
+
+bool Pipeline::stage(const string& name, function<bool ()> body) {
+  auto start = chrono::steady_clock::now();
+  bool result = body();
+  chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+  lock_guard<mutex> lock(consoleLock);
+  cout << "[" << name << "] " << (result? "done" : "FAILED") << " in "
+       << fixed << setprecision(1) << elapsed.count() << "ms" << endl;
+  return result;
+}
+
+bool Pipeline::stage(const GradingJob& job, const string& name, function<bool ()> body) {
+  auto start = chrono::steady_clock::now();
+  bool result = stage(name, body);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+  /* A stage that runs more than once, as in watch mode, accumulates its time. */
+  lock_guard<mutex> lock(metricsLock);
+  auto& times = stageTimes[job.assemblyDirectory];
+  for (auto& entry: times) {
+    if (entry.first == name) {
+      entry.second += elapsed.count();
+      return result;
+    }
+  }
+  times.emplace_back(name, elapsed.count());
+  return result;
+}
+
+void Pipeline::writeMetrics(const GradingJob& job, bool success) {
+  vector<pair<string, double>> times;
+  {
+    lock_guard<mutex> lock(metricsLock);
+    times = stageTimes[job.assemblyDirectory];
+    stageTimes.erase(job.assemblyDirectory);
+  }
+  if (job.metricsFile.empty()) return;
+
+  /* The student's code and the tests are compiled in separate stages, and the tests are
+   * linked in one of their own.
+   */
+  double compileSeconds = 0, linkSeconds = 0;
+  for (const auto& entry: times) {
+    if (entry.first == kCompileSubmission || entry.first == kCompileTests) compileSeconds += entry.second;
+    if (entry.first == kLinkTests) linkSeconds += entry.second;
+  }
+
+  ofstream out(job.metricsFile);
+  out << setprecision(9);
+  out << "# TYPE autograder_pipeline_success gauge" << '\n'
+      << "# HELP autograder_pipeline_success Whether the submission built and its tests ran." << '\n'
+      << "autograder_pipeline_success " << (success? 1 : 0) << '\n'
+      << "# TYPE autograder_pipeline_compile_seconds gauge" << '\n'
+      << "# HELP autograder_pipeline_compile_seconds Time spent compiling the submission and the tests." << '\n'
+      << "autograder_pipeline_compile_seconds " << compileSeconds << '\n'
+      << "# TYPE autograder_pipeline_link_seconds gauge" << '\n'
+      << "# HELP autograder_pipeline_link_seconds Time spent linking the tests." << '\n'
+      << "autograder_pipeline_link_seconds " << linkSeconds << '\n'
+      << "# TYPE autograder_pipeline_stage_seconds gauge" << '\n'
+      << "# HELP autograder_pipeline_stage_seconds Time spent in each stage of the pipeline." << '\n';
+  for (const auto& entry: times) {
+    out << "autograder_pipeline_stage_seconds{stage=\"" << entry.first << "\"} " << entry.second << '\n';
+  }
+
+  /* run-tests ends its metrics with the end-of-file marker, which has to come last. */
+  istringstream testMetrics(contentsOf(job.assemblyDirectory + "/" + kTestMetrics));
+  for (string line; getline(testMetrics, line); ) {
+    if (line != "# EOF") out << line << '\n';
+  }
+  out << "# EOF" << '\n';
+}
+
+bool Pipeline::build(const string& directory, const string& resultsFile,
+                     const vector<string>& makeFlags) {
+  vector<string> command = { "make" };
+  command.insert(command.end(), makeFlags.begin(), makeFlags.end());
+
+  if (runCommand(command, directory, kErrorLog)) return true;
+
+  reportError("The code you submitted did not compile. Compiler error log:\n" +
+              contentsOf(directory + "/" + kErrorLog), resultsFile);
+  return false;
+}
+
+bool Pipeline::canReuseTestObjects(const GradingJob& job) {
+  if (!filesystem::is_directory(config.testObjectCache)) return false;
+
+  /* The tests were compiled against the starter versions of any headers, so if the student
+   * changed one of those, everything needs to be recompiled.
+   */
+  for (const auto& name: manifest) {
+    if (isSourceFile(name)) continue;
+
+    string starter = config.buildDirectory + "/" + name;
+    if (!filesystem::exists(starter) ||
+        contentsOf(starter) != contentsOf(job.assemblyDirectory + "/" + name)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Pipeline::restoreTests(const GradingJob& job, const string& destination) {
+  if (!copyTree(config.testsDirectory, destination) ||
+      !copyTree(config.driverDirectory, destination)) {
+    reportError("An internal error occurred copying the tests. Please contact the course staff.", job.resultsFile);
+    return false;
+  }
+
+  if (!canReuseTestObjects(job)) return true;
+
+  /* Bring over the object file for each test source that hasn't changed since setup. Since
+   * copyTree preserved modification times, make will see these as up to date.
+   */
+  error_code error;
+  for (filesystem::recursive_directory_iterator itr(destination, error), end; !error && itr != end; itr.increment(error)) {
+    if (!isSourceFile(itr->path())) continue;
+
+    auto relative = filesystem::relative(itr->path(), destination).replace_extension(".o");
+    auto cached   = filesystem::path(config.testObjectCache) / relative;
+    if (filesystem::exists(cached) &&
+        filesystem::last_write_time(cached) >= filesystem::last_write_time(itr->path())) {
+      copyFile(cached.string(), (filesystem::path(destination) / relative).string());
+    }
+  }
+  return true;
+}
+
+bool Pipeline::assemble(const GradingJob& job) {
+  string staging = job.assemblyDirectory + ".tests";
+
+  bool success =
+    stage(job, "prepare", [&] {
+      error_code error;
+      filesystem::remove_all(job.assemblyDirectory, error);
+      filesystem::remove_all(job.assemblyDirectory + kSanitizedSuffix, error);
+      filesystem::remove_all(staging, error);
+      filesystem::remove(job.missingList, error);
+      filesystem::create_directories(filesystem::absolute(job.resultsFile).parent_path(), error);
+      return !error;
+    }) &&
+    stage(job, "copy build directory", [&] {
+      if (copyTree(config.buildDirectory, job.assemblyDirectory)) return true;
+      reportError("An internal error occurred setting up the build. Please contact the course staff.", job.resultsFile);
+      return false;
+    }) &&
+    stage(job, "copy submission", [&] {
+      return copySubmission(manifest, job.submissionDirectory, config.defaultsDirectory,
+                            job.assemblyDirectory, job.missingList, job.resultsFile);
+    });
+  if (!success) return false;
+
+  /* Compiling the student's code and restoring the tests don't depend on one another, so
+   * they run at the same time. The tests are restored into a separate directory so that
+   * the student build doesn't pick them up.
+   */
+  auto restored = async(launch::async, [&] {
+    return stage(job, "restore tests", [&] { return restoreTests(job, staging); });
+  });
+  bool built = stage(job, kCompileSubmission, [&] {
+    return build(job.assemblyDirectory, job.resultsFile);
+  });
+
+  if (!restored.get() || !built) return false;
+
+  return stage(job, "merge tests", [&] {
+      error_code error;
+      bool moved = moveTree(staging, job.assemblyDirectory);
+      filesystem::remove_all(staging, error);
+      if (moved) return true;
+
+      reportError("An internal error occurred copying the tests. Please contact the course staff.", job.resultsFile);
+      return false;
+    }) &&
+    stage(job, kCompileTests, [&] {
+      return build(job.assemblyDirectory, job.resultsFile, { "-f", "Makefile.tests", "objects" });
+    }) &&
+    stage(job, kLinkTests, [&] {
+      return build(job.assemblyDirectory, job.resultsFile, { "-f", "Makefile.tests" });
+    });
+}
+
+bool Pipeline::runTests(const GradingJob& job, const vector<string>& extraFlags) {
+  return stage(job, "run tests", [&] {
+    vector<string> command = {
+      "./run-tests",
+      "-o", absolute(job.resultsFile),
+      "-m", absolute(job.missingList),
+      "-j", absolute(config.outputConfig),
+      "-t", absolute(job.timingDatabase.empty()? config.timingDatabase : job.timingDatabase),
+      "-p", to_string(config.testJobs)
+    };
+    if (filesystem::exists(config.calibrationFile)) {
+      command.insert(command.end(), { "-c", absolute(config.calibrationFile) });
+    }
+    if (filesystem::is_directory(config.testDataDirectory)) {
+      command.insert(command.end(), { "--test-data", absolute(config.testDataDirectory) });
+    }
+    command.insert(command.end(), extraFlags.begin(), extraFlags.end());
+    if (job.impactMap.empty()) return runCommand(command, job.assemblyDirectory);
+
+    /* If the run doesn't finish, the saved outcomes can't be trusted, so the next run starts
+     * over from nothing.
+     */
+    auto impact = selectAffectedTests(job, command);
+    error_code error;
+    filesystem::remove(job.impactMap, error);
+    if (!runCommand(command, job.assemblyDirectory)) return false;
+
+    saveImpactMap(job.impactMap, impact);
+    return true;
+  });
+}
+
+ImpactMap Pipeline::selectAffectedTests(const GradingJob& job, vector<string>& command) {
+  vector<string> testFiles;
+  error_code error;
+  for (filesystem::recursive_directory_iterator itr(config.testsDirectory, error), end; !error && itr != end; itr.increment(error)) {
+    if (isSourceFile(itr->path())) {
+      testFiles.push_back(filesystem::relative(itr->path(), config.testsDirectory).string());
+    }
+  }
+
+  /* Headers can change code inlined into anything, and the rest of these change how every
+   * test is run.
+   */
+  vector<string> sharedFiles = { config.outputConfig, config.calibrationFile, job.missingList };
+  for (const auto& name: manifest) {
+    if (!isSourceFile(name)) sharedFiles.push_back(job.assemblyDirectory + "/" + name);
+  }
+  vector<string> dataFiles;
+  for (filesystem::recursive_directory_iterator itr(config.testDataDirectory, error), end; !error && itr != end; itr.increment(error)) {
+    if (itr->is_regular_file()) dataFiles.push_back(itr->path().string());
+  }
+
+  auto impact = mapImpact(job.assemblyDirectory, testFiles, studentObjects(), sharedFiles, dataFiles);
+
+  bool everything;
+  auto affected = affectedTests(loadImpactMap(job.impactMap), impact, everything);
+  command.insert(command.end(), { "--save-outcomes", absolute(job.savedOutcomes) });
+  if (everything || !filesystem::exists(job.savedOutcomes)) {
+    cout << "Running all tests; there's no earlier run that's safe to reuse." << endl;
+    return impact;
+  }
+
+  for (const auto& file: testFiles) {
+    auto reason = affected.find(file);
+    if (reason == affected.end()) {
+      cout << "Reusing results for " << file << "; nothing it depends on changed." << endl;
+    } else {
+      cout << "Rerunning " << file << " (" << reason->second << ")." << endl;
+      command.insert(command.end(), { "--from-file", file });
+    }
+  }
+  command.insert(command.end(), { "--reuse-outcomes", absolute(job.savedOutcomes) });
+  return impact;
+}
+
+vector<string> Pipeline::studentObjects() {
+  set<string> result;
+
+  error_code error;
+  for (filesystem::recursive_directory_iterator itr(config.buildDirectory, error), end; !error && itr != end; itr.increment(error)) {
+    if (isSourceFile(itr->path())) {
+      result.insert(filesystem::relative(itr->path(), config.buildDirectory).replace_extension(".o").string());
+    }
+  }
+  for (const auto& name: manifest) {
+    if (isSourceFile(name)) result.insert(filesystem::path(name).replace_extension(".o").string());
+  }
+
+  return vector<string>(result.begin(), result.end());
+}
+
+bool Pipeline::refreshSubmission(const GradingJob& job, bool& headersChanged) {
+  /* Rather than reimplementing how submitted files are found, we copy the submission
+   * somewhere else and see what's different.
+   */
+  string staging = job.assemblyDirectory + ".submission";
+  error_code error;
+  filesystem::remove_all(staging, error);
+  filesystem::create_directories(staging, error);
+
+  bool success = copySubmission(manifest, job.submissionDirectory, config.defaultsDirectory,
+                                staging, job.missingList, job.resultsFile);
+  for (const auto& name: manifest) {
+    if (!success) break;
+
+    string source      = staging + "/" + name;
+    string destination = job.assemblyDirectory + "/" + name;
+    if (filesystem::exists(destination) && contentsOf(source) == contentsOf(destination)) continue;
+
+    /* This also marks the file as new, so make rebuilds it. */
+    success = linkOrCopy(source, destination);
+    if (!isSourceFile(name)) headersChanged = true;
+  }
+
+  filesystem::remove_all(staging, error);
+  return success;
+}
+
+void Pipeline::removeObjects(const GradingJob& job) {
+  set<filesystem::path> driverObjects;
+
+  error_code error;
+  for (filesystem::recursive_directory_iterator itr(config.driverDirectory, error), end; !error && itr != end; itr.increment(error)) {
+    if (isSourceFile(itr->path())) {
+      driverObjects.insert(filesystem::relative(itr->path(), config.driverDirectory).replace_extension(".o"));
+    }
+  }
+
+  vector<filesystem::path> stale;
+  for (filesystem::recursive_directory_iterator itr(job.assemblyDirectory, error), end; !error && itr != end; itr.increment(error)) {
+    if (itr->path().extension() == ".o" &&
+        !driverObjects.count(filesystem::relative(itr->path(), job.assemblyDirectory))) {
+      stale.push_back(itr->path());
+    }
+  }
+  for (const auto& path: stale) {
+    filesystem::remove(path, error);
+  }
+}
+
+bool Pipeline::update(const GradingJob& job, const set<string>& changed, Rerun& rerun) {
+  /* Our Makefiles don't track which headers each file includes, so if a header changes,
+   * everything gets rebuilt.
+   */
+  bool headersChanged = false;
+  bool submissionChanged = false;
+  bool removedFiles = false;
+
+  bool success = stage(job, "copy changes", [&] {
+    for (const auto& path: changed) {
+      filesystem::path changedPath(path);
+      string root     = changedPath.begin()->string();
+      auto   relative = changedPath.lexically_relative(root);
+      auto   copy     = filesystem::path(job.assemblyDirectory) / relative;
+
+      /* Manifest files come from the submission, even if the starter version changed. */
+      bool isStudentFile = root == job.submissionDirectory ||
+                           (root == config.buildDirectory &&
+                            find(manifest.begin(), manifest.end(), relative.string()) != manifest.end());
+      if (isStudentFile) {
+        /* The assembly directory may hold a hard link to the submitted file, in which
+         * case it already has the new contents and we can't tell it changed by looking.
+         */
+        submissionChanged = true;
+        if (!isSourceFile(relative)) headersChanged = true;
+        continue;
+      }
+      if (root != config.testsDirectory && root != config.buildDirectory) continue;
+
+      if (root == config.testsDirectory && isSourceFile(relative)) {
+        rerun.testFiles.push_back(relative.string());
+      } else {
+        rerun.everything = true;
+        if (!isSourceFile(relative)) headersChanged = true;
+      }
+
+      error_code error;
+      if (filesystem::exists(path)) {
+        filesystem::create_directories(copy.parent_path(), error);
+        if (!linkOrCopy(path, copy.string())) return false;
+      } else {
+        filesystem::remove(copy, error);
+        filesystem::remove(filesystem::path(copy).replace_extension(".o"), error);
+        removedFiles = true;
+      }
+    }
+
+    if (submissionChanged) {
+      rerun.everything = true;
+      return refreshSubmission(job, headersChanged);
+    }
+    return true;
+  });
+  if (!success) return false;
+
+  if (headersChanged) removeObjects(job);
+
+  /* run-tests doesn't know to relink when an object goes away, so make it. */
+  if (removedFiles) {
+    error_code error;
+    filesystem::remove(job.assemblyDirectory + "/run-tests", error);
+  }
+
+  /* The student's Makefile would try to build the tests too, so we name its targets. */
+  return stage(job, kCompileSubmission, [&] {
+      return build(job.assemblyDirectory, job.resultsFile, studentObjects());
+    }) &&
+    stage(job, kCompileTests, [&] {
+      return build(job.assemblyDirectory, job.resultsFile, { "-f", "Makefile.tests", "objects" });
+    }) &&
+    stage(job, kLinkTests, [&] {
+      return build(job.assemblyDirectory, job.resultsFile, { "-f", "Makefile.tests" });
+    });
+}
+
+bool Pipeline::grade(const GradingJob& job) {
+  if (!assemble(job)) {
+    writeMetrics(job, false);
+    return false;
+  }
+
+  /* The sanitized build runs as a separate copy of this program, so that it can be
+   * killed without waiting if no test needs it.
+   */
+  pid_t sanitizer = startCommand({ "/proc/self/exe", "--build-sanitized", absolute(job.assemblyDirectory) }, ".");
+  bool success = runTests(job, { "--sanitized-runner", absolute(sanitizedRunner(job)),
+                                 "--metrics", kTestMetrics });
+  stopCommand(sanitizer);
+
+  writeMetrics(job, success);
+  return success;
+}
+
+string Pipeline::sanitizedRunner(const GradingJob& job) const {
+  return job.assemblyDirectory + kSanitizedSuffix + "/run-tests" + kSanitizedSuffix;
+}
+
+bool Pipeline::buildSanitized(const GradingJob& job) {
+  string directory = job.assemblyDirectory + kSanitizedSuffix;
+  string runner    = sanitizedRunner(job);
+
+  /* The tests are being timed while this runs, and most submissions never need it. */
+  yieldToTests();
+
+  error_code error;
+  filesystem::remove_all(directory, error);
+
+  /* Whatever happens, say so. Our own output would interrupt the test log. */
+  auto finish = [&](bool success) {
+    if (!success) ofstream(runner + ".failed");
+    return success;
+  };
+  if (!copyTree(job.assemblyDirectory, directory)) return finish(false);
+  if (!freopen((directory + "/.autograder.build.log").c_str(), "w", stdout)) return finish(false);
+
+  /* Start from scratch, since every object needs the sanitizers compiled in. */
+  vector<filesystem::path> stale;
+  for (filesystem::recursive_directory_iterator itr(directory, error), end; !error && itr != end; itr.increment(error)) {
+    if (itr->path().extension() == ".o") stale.push_back(itr->path());
+  }
+  stale.push_back(directory + "/run-tests");
+  for (const auto& path: stale) {
+    filesystem::remove(path, error);
+  }
+
+  /* The Makefiles call g++ directly, so we put one first in the PATH that adds our flags. */
+  string compiler = findProgram("g++");
+  if (compiler.empty()) return finish(false);
+
+  string wrapperDirectory = filesystem::absolute(directory + "/.autograder.sanitizer").string();
+  filesystem::create_directories(wrapperDirectory, error);
+  {
+    ofstream wrapper(wrapperDirectory + "/g++");
+    wrapper << "#!/bin/sh" << endl
+            << "exec \"" << compiler << "\" \"$@\" " << kSanitizerFlags << endl;
+  }
+  filesystem::permissions(wrapperDirectory + "/g++", filesystem::perms::owner_all, error);
+  if (error) return finish(false);
+
+  setenv("PATH", (wrapperDirectory + ":" + getenv("PATH")).c_str(), 1);
+
+  vector<string> studentBuild = { "make" };
+  for (const auto& object: studentObjects()) {
+    studentBuild.push_back(object);
+  }
+  if (!runCommand(studentBuild, directory, kErrorLog) ||
+      !runCommand({ "make", "-f", "Makefile.tests" }, directory, kErrorLog)) {
+    return finish(false);
+  }
+
+  /* Renaming is atomic, so the runner never shows up half-written. */
+  return finish(rename((directory + "/run-tests").c_str(), runner.c_str()) == 0);
+}
+
+bool Pipeline::setUp() {
+  /* Build everything in the build-directory once as a clean build so that we don't have
+   * to recompile things later.
+   */
+  if (!stage("build starter code", [&] {
+    return build(config.buildDirectory, kResultsFile);
+  })) return false;
+
+  /* Prebuild the tests against the starter code. If that doesn't work, we just won't have
+   * a cache, and everything gets built at grading time instead.
+   */
+  stage("prebuild tests", [&] {
+    error_code error;
+    filesystem::remove_all(config.testObjectCache, error);
+
+    if (copyTree(config.buildDirectory, config.testObjectCache) &&
+        copyTree(config.testsDirectory, config.testObjectCache) &&
+        copyTree(config.driverDirectory, config.testObjectCache) &&
+        runCommand({ "make", "-f", "Makefile.tests" }, config.testObjectCache, kErrorLog)) {
+      return true;
+    }
+
+    filesystem::remove_all(config.testObjectCache, error);
+    return false;
+  });
+  return true;
+}
+
+bool Pipeline::listTests() {
+  /* The tests get built where setup would have prebuilt them, so that a dry run afterwards
+   * doesn't have to compile them again.
+   */
+  return stage("collect tests", [&] {
+      error_code error;
+      filesystem::remove_all(config.testObjectCache, error);
+      if (!copyTree(config.buildDirectory, config.testObjectCache)) return false;
+
+      /* Only the starter headers are needed. Makefile.tests builds every source file it
+       * finds, so the starter code has to go, along with anything built from it.
+       */
+      vector<filesystem::path> sources;
+      for (filesystem::recursive_directory_iterator itr(config.testObjectCache, error), end; !error && itr != end; itr.increment(error)) {
+        if (isSourceFile(itr->path()) || itr->path().extension() == ".o") sources.push_back(itr->path());
+      }
+      for (const auto& path: sources) {
+        filesystem::remove(path, error);
+      }
+
+      return copyTree(config.testsDirectory, config.testObjectCache) &&
+             copyTree(config.driverDirectory, config.testObjectCache);
+    }) &&
+    stage(kCompileTests, [&] {
+      return build(config.testObjectCache, kResultsFile, { "-f", "Makefile.tests", "objects" });
+    }) &&
+    stage("list tests", [&] {
+      return build(config.testObjectCache, kResultsFile, { "-f", "Makefile.tests", "list-tests" }) &&
+             runCommand({ "./list-tests", "--test-manifest", absolute(config.testManifest) }, config.testObjectCache);
+    });
+}
+
+void Pipeline::clean() {
+  runCommand({ "make", "clean" }, config.buildDirectory);
+  runCommand({ "make", "-f", "Makefile.tests", "clean" }, config.driverDirectory);
+
+  error_code error;
+  filesystem::remove_all(config.testObjectCache, error);
+}
@@ -0,0 +1,188 @@
+/* Types and functions for the grading pipeline: the sequence of stages that takes a student
+ * submission, builds it together with the tests, and runs those tests.
+ */
+
+#ifndef Pipeline_Included
+#define Pipeline_Included
+
+#include "Impact.h"
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <functional>
+#include <cstddef>
+
+/* Settings shared by every submission that gets graded. Paths are relative to the root of
+ * the autograder.
+ */
+struct PipelineConfig {
+  std::string buildDirectory    = "build-directory";
+  std::string testsDirectory    = "tests";
+  std::string driverDirectory   = "test-driver";
+  std::string defaultsDirectory = "default-files";
+  std::string outputConfig      = "output-config.json";
+  std::string manifestFile      = "MANIFEST";
+
+  /* Files for tests to read and write, if the autograder has any. Each test gets a private
+   * scratch copy of them to work in.
+   */
+  std::string testDataDirectory = "test-data";
+
+  /* Where setup, or listing the tests, leaves prebuilt copies of the test objects. */
+  std::string testObjectCache   = ".autograder.test-objects";
+
+  /* How long each test took in earlier runs, used to decide what order to run them in. */
+  std::string timingDatabase    = "test-timings.json";
+
+  /* Per-test timeouts derived from the reference solution, if calibration has been run. */
+  std::string calibrationFile   = "calibration.json";
+
+  /* Every test's name, points, visibility, and required files, as worked out from the tests
+   * alone by listTests().
+   */
+  std::string testManifest      = "test-manifest.json";
+
+  /* How many tests to run at once. */
+  std::size_t testJobs = 1;
+};
+
+/* Where a single submission comes from and where everything about it goes. */
+struct GradingJob {
+  std::string submissionDirectory = "submission";
+  std::string assemblyDirectory   = "assembly";
+  std::string resultsFile         = "results/results.json";
+  std::string missingList         = ".autograder.missing.files";
+
+  /* Where to load and save test timings, if not the shared database in PipelineConfig. */
+  std::string timingDatabase;
+
+  /* What each test file depended on in the last run, and how its tests turned out. When
+   * these are set, a later run of the same job only runs the tests that depend on something
+   * that changed and reuses the results of the rest. Working that out takes time, and a
+   * one-off run has nothing to reuse, so they're empty unless asked for.
+   */
+  std::string impactMap;
+  std::string savedOutcomes;
+
+  /* Where grade() writes statistics about the run in the OpenMetrics text format, for a
+   * collector to pick up. Empty to skip them.
+   */
+  std::string metricsFile     = "results/metrics.prom";
+};
+
+/* Which tests need to run again after an update. */
+struct Rerun {
+  bool everything = false;
+  std::vector<std::string> testFiles; // Relative to the tests directory
+};
+
+class Pipeline {
+public:
+  explicit Pipeline(const PipelineConfig& config);
+
+  /* Builds the student's submission and the tests into the job's assembly directory,
+   * returning whether that worked. Problems are reported to the student via reportError.
+   */
+  bool assemble(const GradingJob& job);
+
+  /* Runs the tests in an assembled directory, returning whether that worked. Any extra
+   * flags are passed along to run-tests. If the job keeps an impact map, tests that nothing
+   * has changed under since the last run aren't run again.
+   */
+  bool runTests(const GradingJob& job, const std::vector<std::string>& extraFlags = {});
+
+  /* Brings an assembled directory up to date after the given files have changed, then
+   * rebuilds whatever depends on them. Paths start with the directory they're in, as in
+   * tests/Tests.cpp. Returns whether everything built, filling in which tests need to be
+   * run again.
+   */
+  bool update(const GradingJob& job, const std::set<std::string>& changed, Rerun& rerun);
+
+  /* Assembles everything, then runs the tests. Meanwhile, a copy of the tests built with
+   * the sanitizers is prepared in the background, so that any tests that crash, throw, or
+   * time out can be run again under it to find out why.
+   */
+  bool grade(const GradingJob& job);
+
+  /* Builds a copy of an assembled directory with AddressSanitizer and UndefinedBehavior-
+   * Sanitizer turned on. When it's done, its runner is at sanitizedRunner(job); if the
+   * build fails, a file with ".failed" added to that name appears instead. The build only
+   * uses CPU time the tests don't, so that it can't make them slower. Returns whether the
+   * build worked.
+   */
+  bool buildSanitized(const GradingJob& job);
+
+  /* Where buildSanitized() leaves the sanitized test runner for a job. */
+  std::string sanitizedRunner(const GradingJob& job) const;
+
+  /* One-time setup run when the autograder is installed: builds the starter code and
+   * prebuilds the test objects so that grading doesn't have to.
+   */
+  bool setUp();
+
+  /* Writes the test manifest. This only compiles the tests against the starter headers and
+   * links them with the driver, leaving out the student's code entirely, so it doesn't need
+   * a submission and doesn't build one. Returns whether that worked.
+   */
+  bool listTests();
+
+  /* Removes everything built by setUp() or by a dry run. */
+  void clean();
+
+private:
+  PipelineConfig config;
+  std::vector<std::string> manifest;
+
+  /* How long each stage took for each job in progress, keyed by assembly directory and
+   * kept until the job's metrics are written.
+   */
+  std::mutex metricsLock;
+  std::map<std::string, std::vector<std::pair<std::string, double>>> stageTimes;
+
+  /* Runs a stage of the pipeline and reports how long it took. Stages run on behalf of a
+   * job also count towards its metrics.
+   */
+  bool stage(const std::string& name, std::function<bool ()> body);
+  bool stage(const GradingJob& job, const std::string& name, std::function<bool ()> body);
+
+  /* Writes out a job's metrics: how long each stage took, whether grading worked, and
+   * everything run-tests recorded about running the tests.
+   */
+  void writeMetrics(const GradingJob& job, bool success);
+
+  /* Runs make in the given directory, reporting any compiler errors to the student. */
+  bool build(const std::string& directory, const std::string& resultsFile,
+             const std::vector<std::string>& makeFlags = {});
+
+  /* Copies the tests and test driver into the given directory, along with whichever of
+   * their prebuilt objects are safe to reuse for this submission.
+   */
+  bool restoreTests(const GradingJob& job, const std::string& destination);
+
+  /* Returns whether test objects built against the starter code are still valid for the
+   * submission in the given assembly directory.
+   */
+  bool canReuseTestObjects(const GradingJob& job);
+
+  /* Works out which test files need to run again in an assembled directory, adding the
+   * flags that tell run-tests so to the command. Returns the directory's new impact map.
+   */
+  ImpactMap selectAffectedTests(const GradingJob& job, std::vector<std::string>& command);
+
+  /* Returns the object files the student's Makefile is responsible for. */
+  std::vector<std::string> studentObjects();
+
+  /* Copies the student's files into the assembly directory again, replacing only those
+   * whose contents changed. Returns whether that worked, setting headersChanged if any
+   * file that wasn't a source file was replaced.
+   */
+  bool refreshSubmission(const GradingJob& job, bool& headersChanged);
+
+  /* Deletes every object file in the assembly directory except for the test driver's. */
+  void removeObjects(const GradingJob& job);
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "SubmissionIndex.h"
+#include "ToolCommon.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+/* * * * * SubmissionIndex Implementation * * * * */
+SubmissionIndex::SubmissionIndex(const string& root) {
+  error_code error;
+  for (filesystem::recursive_directory_iterator itr(root, error), end; !error && itr != end; itr.increment(error)) {
+    if (itr->is_regular_file(error)) {
+      files[itr->path().filename().string()].push_back(itr->path().string());
+    }
+  }
+}
+
+vector<string> SubmissionIndex::filesNamed(const string& name) const {
+  auto itr = files.find(name);
+  return itr == files.end()? vector<string>() : itr->second;
+}
+
+/* * * * * Manifest Handling * * * * */
+namespace {
+  /* Strips leading and trailing whitespace. */
+  string trim(const string& line) {
+    const string kWhitespace = " \t\r\n";
+    auto start = line.find_first_not_of(kWhitespace);
+    if (start == string::npos) return "";
+    return line.substr(start, line.find_last_not_of(kWhitespace) - start + 1);
+  }
+}
+
+vector<string> readManifest(const string& manifestFile) {
+  ifstream input(manifestFile);
+  if (!input) throw runtime_error("Manifest file " + manifestFile + " not found.");
+
+  vector<string> result;
+  for (string line; getline(input, line); ) {
+    line = trim(line);
+
+    /* Skip empty lines or lines starting with #. */
+    if (line.empty() || line[0] == '#') continue;
+    result.push_back(line);
+  }
+  return result;
+}
+
+bool copySubmission(const vector<string>& manifest,
+                    const string& submissionDirectory,
+                    const string& defaultsDirectory,
+                    const string& destination,
+                    const string& missingList,
+                    const string& resultsFile) {
+  cout << "Copying student submission:" << endl;
+
+  SubmissionIndex index(submissionDirectory);
+  vector<string> missing;
+
+  for (const auto& name: manifest) {
+    auto submitted = index.filesNamed(name);
+
+    /* If too many files are found, we have to panic and give up. */
+    if (submitted.size() >= 2) {
+      reportError("Multiple copies of " + name + " were submitted; not sure which to use.", resultsFile);
+      return false;
+    }
+
+    string source;
+    if (submitted.empty()) {
+      /* If no files are found, see if there's a fallback. */
+      source = defaultsDirectory + "/" + name;
+      if (!filesystem::is_regular_file(source)) {
+        cout << "No submission for " << name << "; no fallback exists." << endl;
+        reportError("You need to submit a source file named " + name + ".", resultsFile);
+        return false;
+      }
+
+      cout << "  NOT SUBMITTED: " << name << "; using fallback." << endl;
+      missing.push_back(name);
+    } else {
+      source = submitted[0];
+      cout << "      SUBMITTED: " << name << endl;
+    }
+
+    if (!linkOrCopy(source, destination + "/" + name)) {
+      reportError("An internal error occurred trying to copy " + name + ". Please contact the course staff.", resultsFile);
+      return false;
+    }
+  }
+
+  /* Record which files are missing, if any. */
+  if (!missing.empty()) {
+    ofstream output(missingList);
+    for (const auto& name: missing) {
+      output << name << endl;
+    }
+    if (!output) {
+      reportError("An internal error occurred recording missing files. Please contact the course staff.", resultsFile);
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,40 @@
+/* Types and functions for finding the files a student submitted. Students don't always
+ * submit files in the places we expect, so we match files by name anywhere in the
+ * submission tree.
+ */
+
+#ifndef SubmissionIndex_Included
+#define SubmissionIndex_Included
+
+#include <string>
+#include <vector>
+#include <map>
+
+/* Index of every file in a directory tree, built in a single pass and keyed by file name. */
+class SubmissionIndex {
+public:
+  explicit SubmissionIndex(const std::string& root);
+
+  /* Returns the paths of all files with the given name. */
+  std::vector<std::string> filesNamed(const std::string& name) const;
+
+private:
+  std::map<std::string, std::vector<std::string>> files;
+};
+
+/* Returns the file names listed in a MANIFEST file, skipping blank lines and comments. */
+std::vector<std::string> readManifest(const std::string& manifestFile);
+
+/* Copies each file named in the manifest from the submission directory into the destination
+ * directory, falling back on the version in defaultsDirectory if the student didn't submit
+ * one. The names of files that fell back are written to missingList. Returns whether every
+ * file was found; if not, the problem has been reported with reportError to resultsFile.
+ */
+bool copySubmission(const std::vector<std::string>& manifest,
+                    const std::string& submissionDirectory,
+                    const std::string& defaultsDirectory,
+                    const std::string& destination,
+                    const std::string& missingList,
+                    const std::string& resultsFile);
+
+#endif
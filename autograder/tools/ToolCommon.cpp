@@ -0,0 +1,203 @@
+#include "ToolCommon.h"
+#include "JSON.h"
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <linux/fs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+using namespace std;
+
+const string kResultsFile = "results/results.json";
+
+void reportError(const string& message, const string& resultsFile) {
+  cout << "ERROR: " << message << endl;
+
+  ofstream output(resultsFile);
+  if (!output) {
+    cerr << "Internal error: Cannot open " << resultsFile << " for writing." << endl;
+    return;
+  }
+
+  output << JSON::object({
+    { "tests", vector<JSON>{
+      JSON::object({
+        { "name",   "Autograder Error" },
+        { "score",  0.0                },
+        { "output", message            }
+      })
+    }}
+  });
+}
+
+namespace {
+  /* Tries to make destination a copy-on-write clone of source. */
+  bool reflink(const string& source, const string& destination) {
+    int in = open(source.c_str(), O_RDONLY);
+    if (in == -1) return false;
+
+    int out = open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out == -1) {
+      close(in);
+      return false;
+    }
+
+    bool success = ioctl(out, FICLONE, in) == 0;
+    close(in);
+    close(out);
+
+    if (!success) unlink(destination.c_str());
+    return success;
+  }
+
+  /* Forks off a command in the given directory, returning its process ID. If newGroup is
+   * set, the command and anything it starts go in a process group of their own, so that
+   * stopCommand can get all of them.
+   */
+  pid_t spawn(const vector<string>& command, const string& directory, const string& errorLog,
+              bool newGroup, int outputFD = -1) {
+    vector<char*> args;
+    for (const auto& arg: command) {
+      args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    cout << flush;
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    if (newGroup) setpgid(0, 0);
+    if (chdir(directory.c_str()) == -1) _exit(127);
+
+    if (!errorLog.empty()) {
+      int fd = open(errorLog.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd == -1 || dup2(fd, STDERR_FILENO) == -1) _exit(127);
+      close(fd);
+    }
+    if (outputFD != -1 && dup2(outputFD, STDOUT_FILENO) == -1) _exit(127);
+
+    execvp(args[0], args.data());
+    _exit(127);
+  }
+}
+
+bool linkOrCopy(const string& source, const string& destination) {
+  /* Clear out whatever's already there, such as a starter file from the build directory. */
+  if (unlink(destination.c_str()) == -1 && errno != ENOENT) return false;
+
+  if (!reflink(source, destination) && link(source.c_str(), destination.c_str()) == -1) {
+    error_code error;
+    if (!filesystem::copy_file(source, destination, error)) return false;
+  }
+
+  /* Whatever we ended up with needs to look newer than any object files built from the
+   * file it's replacing, or make won't rebuild them. For a hard link this also touches
+   * the source, which is harmless.
+   */
+  return utimensat(AT_FDCWD, destination.c_str(), nullptr, 0) == 0;
+}
+
+bool copyFile(const string& source, const string& destination) {
+  unlink(destination.c_str());
+
+  error_code error;
+  if (!reflink(source, destination) && !filesystem::copy_file(source, destination, error)) {
+    return false;
+  }
+
+  struct stat info;
+  if (stat(source.c_str(), &info) == -1) return false;
+
+  struct timespec times[2] = { info.st_atim, info.st_mtim };
+  return utimensat(AT_FDCWD, destination.c_str(), times, 0) == 0;
+}
+
+bool copyTree(const string& source, const string& destination) {
+  error_code error;
+  filesystem::create_directories(destination, error);
+  if (error) return false;
+
+  for (filesystem::directory_iterator itr(source, error), end; !error && itr != end; itr.increment(error)) {
+    string target = destination + "/" + itr->path().filename().string();
+
+    if (itr->is_directory(error)) {
+      if (!copyTree(itr->path().string(), target)) return false;
+      continue;
+    }
+
+    if (!copyFile(itr->path().string(), target)) return false;
+  }
+
+  return !error;
+}
+
+bool moveTree(const string& source, const string& destination) {
+  error_code error;
+  for (filesystem::directory_iterator itr(source, error), end; !error && itr != end; itr.increment(error)) {
+    string target = destination + "/" + itr->path().filename().string();
+
+    if (itr->is_directory(error) && filesystem::is_directory(target)) {
+      if (!moveTree(itr->path().string(), target)) return false;
+    } else if (rename(itr->path().c_str(), target.c_str()) == -1) {
+      return false;
+    }
+  }
+
+  return !error;
+}
+
+pid_t startCommand(const vector<string>& command, const string& directory, const string& errorLog) {
+  return spawn(command, directory, errorLog, true);
+}
+
+bool finishCommand(pid_t pid) {
+  if (pid == -1) return false;
+
+  int status;
+  if (waitpid(pid, &status, 0) == -1) return false;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void stopCommand(pid_t pid) {
+  if (pid == -1) return;
+
+  kill(-pid, SIGKILL);
+  finishCommand(pid);
+}
+
+bool runCommand(const vector<string>& command, const string& directory, const string& errorLog) {
+  return finishCommand(spawn(command, directory, errorLog, false));
+}
+
+bool captureCommand(const vector<string>& command, const string& directory, string& output) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) == -1) return false;
+
+  pid_t pid = spawn(command, directory, "/dev/null", false, fds[1]);
+  close(fds[1]);
+
+  output.clear();
+  char buffer[4096];
+  for (ssize_t read; (read = ::read(fds[0], buffer, sizeof(buffer))) != 0; ) {
+    if (read == -1 && errno == EINTR) continue;
+    if (read == -1) break;
+    output.append(buffer, read);
+  }
+  close(fds[0]);
+
+  return finishCommand(pid);
+}
+
+string contentsOf(const string& filename) {
+  ifstream input(filename);
+
+  ostringstream result;
+  result << input.rdbuf();
+  return result.str();
+}
@@ -0,0 +1,72 @@
+/* Utility functions shared by the native tools that assemble and run the autograder. */
+
+#ifndef ToolCommon_Included
+#define ToolCommon_Included
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+/* Where GradeScope expects to find the results of a run. */
+extern const std::string kResultsFile;
+
+/* Reports an error that kept the autograder from running, both to the console and in a
+ * results file that shows the message to the student.
+ */
+void reportError(const std::string& message, const std::string& resultsFile = kResultsFile);
+
+/* Makes the file at destination have the same contents as the file at source, overwriting
+ * whatever is there. This tries a reflink first, then a hard link, and falls back on a
+ * regular copy, so it's cheap whenever the filesystem allows it. Returns whether it
+ * succeeded.
+ */
+bool linkOrCopy(const std::string& source, const std::string& destination);
+
+/* Copies a single file, preserving its modification time. Like copyTree, this never uses a
+ * hard link. Returns whether it succeeded.
+ */
+bool copyFile(const std::string& source, const std::string& destination);
+
+/* Recursively copies the contents of one directory into another, creating the destination
+ * if needed and preserving modification times so that make can tell which object files are
+ * still up to date. Files are reflinked where possible and copied otherwise; they're never
+ * hard-linked, since the build may rewrite them in place. Returns whether it succeeded.
+ */
+bool copyTree(const std::string& source, const std::string& destination);
+
+/* Recursively moves the contents of one directory into another, merging subdirectories
+ * that exist in both and replacing files that do. Returns whether it succeeded.
+ */
+bool moveTree(const std::string& source, const std::string& destination);
+
+/* Runs a command in the given directory, waiting for it to finish. If errorLog is not
+ * empty, the command's stderr is sent to that file. Returns whether the command exited
+ * successfully.
+ */
+bool runCommand(const std::vector<std::string>& command, const std::string& directory,
+                const std::string& errorLog = "");
+
+/* Starts a command in the given directory the same way runCommand does, but without waiting
+ * for it to finish. Returns its process ID, or -1 if it couldn't be started.
+ */
+pid_t startCommand(const std::vector<std::string>& command, const std::string& directory,
+                   const std::string& errorLog = "");
+
+/* Runs a command the same way runCommand does, collecting everything it prints to stdout
+ * into output. Its stderr is thrown away. Returns whether it exited successfully.
+ */
+bool captureCommand(const std::vector<std::string>& command, const std::string& directory,
+                    std::string& output);
+
+/* Waits for a command started with startCommand, returning whether it exited successfully. */
+bool finishCommand(pid_t pid);
+
+/* Kills a command started with startCommand, along with anything it started, and waits for
+ * it to exit.
+ */
+void stopCommand(pid_t pid);
+
+/* Returns the contents of the given file, or the empty string if it can't be read. */
+std::string contentsOf(const std::string& filename);
+
+#endif
@@ -0,0 +1,98 @@
+#include "Watcher.h"
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <filesystem>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+using namespace std;
+
+namespace {
+  /* How long things need to be quiet before we report what changed. */
+  const int kSettleTimeMS = 100;
+
+  /* Events that mean a file's contents may be different. */
+  const uint32_t kFileEvents = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+
+  /* Events that mean a directory appeared and also needs watching. */
+  const uint32_t kDirectoryEvents = IN_CREATE | IN_MOVED_TO;
+
+  /* Returns whether a file name looks like something an editor made on the side, such as
+   * a swap file or a backup, rather than a file someone's working on.
+   */
+  bool isScratchFile(const string& name) {
+    return name.empty() || name[0] == '.' || name.back() == '~' || name[0] == '#';
+  }
+}
+
+Watcher::Watcher(const vector<string>& roots) : fd(inotify_init1(IN_CLOEXEC)) {
+  if (fd == -1) throw runtime_error("Couldn't start watching files: " + string(strerror(errno)));
+
+  for (const auto& root: roots) {
+    if (filesystem::is_directory(root)) watchTree(root);
+  }
+}
+
+Watcher::~Watcher() {
+  close(fd);
+}
+
+void Watcher::watchTree(const string& root, set<string>* files) {
+  int watch = inotify_add_watch(fd, root.c_str(), kFileEvents | kDirectoryEvents | IN_ONLYDIR);
+  if (watch == -1) throw runtime_error("Couldn't watch " + root + ": " + strerror(errno));
+  directories[watch] = root;
+
+  error_code error;
+  for (filesystem::directory_iterator itr(root, error), end; !error && itr != end; itr.increment(error)) {
+    if (isScratchFile(itr->path().filename().string())) continue;
+
+    if (itr->is_directory(error)) {
+      watchTree(itr->path().string(), files);
+    } else if (files) {
+      files->insert(itr->path().string());
+    }
+  }
+}
+
+void Watcher::readEvents(set<string>& changed) {
+  alignas(inotify_event) char buffer[64 * 1024];
+
+  auto bytes = read(fd, buffer, sizeof(buffer));
+  if (bytes == -1) {
+    if (errno == EINTR) return;
+    throw runtime_error("Couldn't read file changes: " + string(strerror(errno)));
+  }
+
+  for (char* next = buffer; next < buffer + bytes; ) {
+    auto* event = reinterpret_cast<inotify_event*>(next);
+    next += sizeof(inotify_event) + event->len;
+
+    auto directory = directories.find(event->wd);
+    if (directory == directories.end() || event->len == 0) continue;
+
+    string name = event->name;
+    if (isScratchFile(name)) continue;
+
+    string path = directory->second + "/" + name;
+    if (event->mask & IN_ISDIR) {
+      /* Anything already in a new directory got there before we were watching it. */
+      if (event->mask & kDirectoryEvents) watchTree(path, &changed);
+    } else if (event->mask & kFileEvents) {
+      changed.insert(path);
+    }
+  }
+}
+
+set<string> Watcher::waitForChanges() {
+  set<string> changed;
+  while (changed.empty()) {
+    readEvents(changed);
+  }
+
+  pollfd pending = { fd, POLLIN, 0 };
+  while (poll(&pending, 1, kSettleTimeMS) > 0) {
+    readEvents(changed);
+  }
+  return changed;
+}
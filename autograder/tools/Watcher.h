@@ -0,0 +1,42 @@
+/* Type that watches directory trees for changes using inotify. */
+
+#ifndef Watcher_Included
+#define Watcher_Included
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+
+class Watcher {
+public:
+  /* Starts watching the given directories and everything in them. Directories that don't
+   * exist are skipped.
+   */
+  explicit Watcher(const std::vector<std::string>& roots);
+  ~Watcher();
+
+  Watcher(const Watcher &) = delete;
+  void operator= (const Watcher &) = delete;
+
+  /* Waits until something changes, then keeps collecting changes until things have been
+   * quiet for a moment, since saving one file often touches several. Returns the paths of
+   * the files that were written, created, moved, or deleted, each starting with the root
+   * it was found under.
+   */
+  std::set<std::string> waitForChanges();
+
+private:
+  int fd;
+  std::map<int, std::string> directories; // Watch descriptor to path
+
+  /* Adds watches for a directory and everything in it. If files is given, the files found
+   * along the way are added to it.
+   */
+  void watchTree(const std::string& root, std::set<std::string>* files = nullptr);
+
+  /* Reads whatever events are pending, adding changed paths to the given set. */
+  void readEvents(std::set<std::string>& changed);
+};
+
+#endif